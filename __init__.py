@@ -1,14 +1,72 @@
-from binaryninja import PluginCommand
+from binaryninja import PluginCommand, interaction
 
-from .find_jni_methods import FindJNIFunctionAnalysis
+from .find_jni_methods import FindJNIFunctionAnalysis, query_env_calls, format_env_call
 
 
 def locate_jni(bv):
     task = FindJNIFunctionAnalysis(bv)
     task.start()
 
+def locate_jni_unaligned(bv):
+    task = FindJNIFunctionAnalysis(bv, unaligned=True)
+    task.start()
+
+def locate_jni_in_selection(bv, addr, length):
+    task = FindJNIFunctionAnalysis(bv, regions=[(addr, addr + length)])
+    task.start()
+
+def locate_jni_in_section(bv):
+    section_names = sorted(bv.sections)
+    choice = interaction.get_choice_input("Section to scan", "Propagate JNI Types", section_names)
+    if choice is None:
+        return
+
+    task = FindJNIFunctionAnalysis(bv, regions=[section_names[choice]])
+    task.start()
+
+def list_jni_env_calls(bv):
+    env_calls = query_env_calls(bv)
+    if len(env_calls) == 0:
+        print("[!] No JNIEnv calls found, run \"Propagate JNI Types\" first")
+        return
+
+    slot_names = sorted(env_calls)
+    choice = interaction.get_choice_input("JNIEnv function", "Propagate JNI Types", slot_names)
+    if choice is None:
+        return
+
+    slot_name = slot_names[choice]
+    for fun_addr, call_addr, strings in env_calls[slot_name]:
+        funcs = bv.get_functions_at(fun_addr)
+        fun_name = funcs[0].name if len(funcs) > 0 else f"{fun_addr:#x}"
+        print(f"[+] {call_addr:#x} ({fun_name}): {format_env_call(slot_name, strings)}")
+
 PluginCommand.register(
     "Propagate JNI Types",
     "",
     locate_jni
 )
+
+PluginCommand.register(
+    "Propagate JNI Types (Unaligned Scan)",
+    "Scan every byte offset of the data sections for JNINativeMethod tables",
+    locate_jni_unaligned
+)
+
+PluginCommand.register_for_range(
+    "Propagate JNI Types (Scan Selection)",
+    "Scan the new or changed bytes of the selection for JNINativeMethod tables",
+    locate_jni_in_selection
+)
+
+PluginCommand.register(
+    "Propagate JNI Types (Scan Section)",
+    "Scan the new or changed bytes of a section for JNINativeMethod tables",
+    locate_jni_in_section
+)
+
+PluginCommand.register(
+    "Propagate JNI Types (List JNIEnv Calls)",
+    "List the calls of the JNI functions to a JNIEnv function",
+    list_jni_env_calls
+)
@@ -0,0 +1,230 @@
+import os
+import sys
+import json
+import fnmatch
+import zipfile
+import argparse
+import tempfile
+import traceback
+import contextlib
+import multiprocessing
+import concurrent.futures
+import importlib.util
+
+import binaryninja
+
+SCRIPTDIR = os.path.dirname(os.path.realpath(__file__))
+
+# Native libraries of an APK, i.e. lib/<abi>/<name>.so
+APK_LIBRARY_PATTERN = "lib/*/*.so"
+
+# Separator between the path of an APK and the name of a library inside it
+APK_MEMBER_SEPARATOR = "!/"
+
+if __package__:
+    from .find_jni_methods import FindJNIFunctionAnalysis, SCAN_WINDOW_SIZE
+    from .jni_names import demangle_jni_name
+else:
+    # Run as a script (and in the spawned workers): import the plugin package by path
+    spec = importlib.util.spec_from_file_location("jni_plugin",
+        os.path.join(SCRIPTDIR, "__init__.py"), submodule_search_locations=[SCRIPTDIR])
+    jni_plugin = importlib.util.module_from_spec(spec)
+    sys.modules["jni_plugin"] = jni_plugin
+    spec.loader.exec_module(jni_plugin)
+
+    from jni_plugin.find_jni_methods import FindJNIFunctionAnalysis, SCAN_WINDOW_SIZE
+    from jni_plugin.jni_names import demangle_jni_name
+
+def iter_libraries(paths):
+    # Native libraries to analyze: the files given, the .so files under the
+    # directories given and the lib/*/*.so members of the APKs given
+    for path in paths:
+        if os.path.isdir(path):
+            for root, dir_names, file_names in os.walk(path):
+                dir_names.sort()
+                for file_name in sorted(file_names):
+                    if file_name.endswith(".so") or file_name.endswith(".apk"):
+                        yield from iter_libraries([os.path.join(root, file_name)])
+        elif path.endswith(".apk"):
+            try:
+                with zipfile.ZipFile(path) as apk:
+                    for member in apk.namelist():
+                        if fnmatch.fnmatch(member, APK_LIBRARY_PATTERN):
+                            yield path + APK_MEMBER_SEPARATOR + member
+            except (OSError, zipfile.BadZipFile) as e:
+                print(f"[!] {path}: {e}", file=sys.stderr)
+        else:
+            yield path
+
+@contextlib.contextmanager
+def library_file(library):
+    # Path of library on disk, APK members are extracted to a temporary file
+    if APK_MEMBER_SEPARATOR not in library:
+        yield library
+        return
+
+    apk_path, member = library.split(APK_MEMBER_SEPARATOR, 1)
+    with tempfile.TemporaryDirectory(prefix="jni_batch_") as tmp_dir:
+        path = os.path.join(tmp_dir, os.path.basename(member))
+        with zipfile.ZipFile(apk_path) as apk, apk.open(member) as fin, open(path, "wb") as fout:
+            while True:
+                chunk = fin.read(0x100000)
+                if len(chunk) == 0:
+                    break
+                fout.write(chunk)
+        yield path
+
+def open_view(path, trace):
+    # Only the sections and the symbols are needed by the scan: the view is
+    # analyzed (enough to get the MLIL of JNI_OnLoad) only to trace RegisterNatives
+    options = {"analysis.mode": "intermediate"} if trace else {}
+    if hasattr(binaryninja, "load"):
+        return binaryninja.load(path, update_analysis=trace, options=options)
+    return binaryninja.BinaryViewType.get_view_of_file_with_options(path, update_analysis=trace, options=options)
+
+def analyze_library(library, options):
+    # Report of the JNI methods of library, the plugin output goes to stderr
+    report = {"path": library}
+    try:
+        with contextlib.redirect_stdout(sys.stderr), library_file(library) as path:
+            bv = open_view(path, options["trace"])
+            if bv is None:
+                raise ValueError("unable to open the file")
+            try:
+                report.update(collect_methods(bv, options))
+            finally:
+                bv.file.close()
+    except Exception as e:
+        report["error"] = f"{type(e).__name__}: {e}"
+        traceback.print_exc()
+    return report
+
+def collect_methods(bv, options):
+    # Run the discovery phases of FindJNIFunctionAnalysis, dropping the changes
+    # they queue (symbols, data vars, scanned blocks metadata). With --trace the
+    # JNI type library is added to the view, and its types imported, to locate
+    # the RegisterNatives calls. The view is closed without being saved
+    analysis = FindJNIFunctionAnalysis(bv, unaligned=options["unaligned"], workers=options["scan_workers"],
+        use_cache=options["use_cache"], trace=options["trace"], window_size=options["window_size"])
+    if options["trace"]:
+        analysis.define_JNI_types()
+
+    with analysis.stats.phase("dynamic"):
+        analysis.find_dynamic_jni()
+    analysis.pending_changes = list()
+
+    dynamic = list()
+    for addr, _, method_name, _, method_signature, method_ptr in analysis.method_entries:
+        function, thumb = analysis.get_method_address(method_ptr)
+        dynamic.append({
+            "entry":     addr,
+            "name":      method_name,
+            "signature": method_signature,
+            "function":  function,
+            "thumb":     thumb
+        })
+
+    static = list()
+    with analysis.stats.phase("static"):
+        for sym in analysis.iter_static_symbols():
+            class_name, method_name, signature = demangle_jni_name(sym.name) or (None, None, None)
+            static.append({
+                "symbol":    sym.name,
+                "class":     class_name,
+                "name":      method_name,
+                "signature": signature,
+                "function":  sym.address
+            })
+
+    return {
+        "arch":    bv.arch.name,
+        "dynamic": dynamic,
+        "static":  static,
+        "stats":   analysis.stats.as_dict()
+    }
+
+def init_worker(max_memory):
+    # Cap the address space of the worker, the library being analyzed fails
+    # with a MemoryError instead of exhausting the memory of the machine
+    if max_memory is None:
+        return
+    try:
+        import resource
+    except ImportError:
+        return
+    limit = max_memory * 0x100000
+    resource.setrlimit(resource.RLIMIT_AS, (limit, limit))
+
+def make_pool(jobs, tasks_per_worker, max_memory):
+    # Workers are spawned (not forked from a process holding Binary Ninja
+    # state) and replaced after tasks_per_worker libraries, releasing the
+    # memory of the views they analyzed
+    context = multiprocessing.get_context("spawn")
+    try:
+        return concurrent.futures.ProcessPoolExecutor(max_workers=jobs, mp_context=context,
+            initializer=init_worker, initargs=(max_memory, ), max_tasks_per_child=tasks_per_worker)
+    except TypeError:
+        # max_tasks_per_child requires python 3.11
+        return concurrent.futures.ProcessPoolExecutor(max_workers=jobs, mp_context=context,
+            initializer=init_worker, initargs=(max_memory, ))
+
+def iter_reports(libraries, options, jobs, tasks_per_worker, max_memory):
+    # Reports of the libraries, in completion order
+    if jobs <= 1:
+        for library in libraries:
+            yield analyze_library(library, options)
+        return
+
+    with make_pool(jobs, tasks_per_worker, max_memory) as pool:
+        futures = {pool.submit(analyze_library, library, options): library for library in libraries}
+        for future in concurrent.futures.as_completed(futures):
+            try:
+                yield future.result()
+            except Exception as e:
+                # The worker died (e.g. killed when out of memory)
+                yield {"path": futures[future], "error": f"{type(e).__name__}: {e}"}
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Find the JNI methods of native libraries and write them as JSON lines, one per library")
+    parser.add_argument("paths", nargs="+", help="libraries, APKs or directories holding them")
+    parser.add_argument("-o", "--output", default=None, help="report file (default: stdout)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1,
+        help="libraries analyzed in parallel (1 to analyze them in this process)")
+    parser.add_argument("--tasks-per-worker", type=int, default=1,
+        help="libraries analyzed by a worker before it is replaced")
+    parser.add_argument("--max-memory", type=int, default=None, help="address space limit of a worker in MB")
+    parser.add_argument("--scan-workers", type=int, default=1, help="scan workers of each analysis")
+    parser.add_argument("--trace", action="store_true",
+        help="analyze the libraries to locate the tables from the RegisterNatives calls")
+    parser.add_argument("--window-size", type=float, default=SCAN_WINDOW_SIZE / 0x100000,
+        help="bytes of a data section scanned at once, in MB")
+    parser.add_argument("--unaligned", action="store_true", help="scan every byte offset of the data sections")
+    parser.add_argument("--no-cache", action="store_true", help="do not use the JNI methods cache")
+    args = parser.parse_args()
+
+    options = {
+        "trace":        args.trace,
+        "unaligned":    args.unaligned,
+        "scan_workers": args.scan_workers,
+        "window_size":  int(args.window_size * 0x100000),
+        "use_cache":    not args.no_cache
+    }
+
+    libraries = list(iter_libraries(args.paths))
+    print(f"[+] Analyzing {len(libraries)} libraries", file=sys.stderr)
+
+    n_errors = 0
+    with (open(args.output, "w") if args.output is not None else contextlib.nullcontext(sys.stdout)) as fout:
+        for report in iter_reports(libraries, options, args.jobs, args.tasks_per_worker, args.max_memory):
+            if "error" in report:
+                n_errors += 1
+                print(f"[!] {report['path']}: {report['error']}", file=sys.stderr)
+            fout.write(json.dumps(report) + "\n")
+            fout.flush()
+
+    print(f"[+] {len(libraries) - n_errors} libraries analyzed, {n_errors} errors", file=sys.stderr)
+    return 1 if n_errors > 0 else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
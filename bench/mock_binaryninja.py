@@ -0,0 +1,495 @@
+"""
+Lightweight stand-in for the parts of the binaryninja API used by the plugin,
+to run FindJNIFunctionAnalysis headless in the benchmark.
+
+install() registers this module as "binaryninja". MockBinaryView loads a
+simple ELF shared object (as the ones generated by synth_elf): the PT_LOAD
+segments are mapped, the allocated sections get their semantics from their
+flags and the FUNC symbols of .dynsym become functions. Functions have no
+IL unless the benchmark builds it from the IL classes below (see
+run_bench.add_register_natives_il), RegisterNatives tracing falls back to the
+scan otherwise.
+"""
+
+import re
+import sys
+import enum
+import types
+import pickle
+import struct
+import tempfile
+
+class SymbolType(enum.Enum):
+    FunctionSymbol         = 0
+    ImportAddressSymbol    = 1
+    ImportedFunctionSymbol = 2
+    DataSymbol             = 3
+    ImportedDataSymbol     = 4
+
+class Endianness(enum.Enum):
+    LittleEndian = 0
+    BigEndian    = 1
+
+class SectionSemantics(enum.Enum):
+    DefaultSectionSemantics       = 0
+    ReadOnlyCodeSectionSemantics  = 1
+    ReadOnlyDataSectionSemantics  = 2
+    ReadWriteDataSectionSemantics = 3
+    ExternalSectionSemantics      = 4
+
+class MediumLevelILOperation(enum.Enum):
+    MLIL_CONST           = 0
+    MLIL_ADD             = 1
+    MLIL_LOAD            = 2
+    MLIL_LOAD_SSA        = 3
+    MLIL_VAR_SSA         = 4
+    MLIL_VAR_ALIASED     = 5
+    MLIL_CALL_SSA        = 6
+    MLIL_TAILCALL_SSA    = 7
+    MLIL_LOAD_STRUCT     = 8
+    MLIL_LOAD_STRUCT_SSA = 9
+
+class RegisterValueType(enum.Enum):
+    UndeterminedValue    = 0
+    ConstantValue        = 1
+    ConstantPointerValue = 2
+
+class RegisterValue(object):
+    def __init__(self, value_type=RegisterValueType.UndeterminedValue, value=0):
+        self.type  = value_type
+        self.value = value
+
+class SSAVariable(object):
+    def __init__(self, var, version):
+        self.var     = var
+        self.version = version
+
+class MediumLevelILInstruction(object):
+    # Expression of the MLIL SSA form: the operands are given as keyword arguments
+    def __init__(self, operation, value=None, **operands):
+        self.operation = operation
+        self.value     = value or RegisterValue()
+        self.__dict__.update(operands)
+
+class MediumLevelILFunction(object):
+    # MLIL of a function, which is its own SSA form
+    def __init__(self, instructions, definitions=None):
+        self.instructions = instructions
+        self.definitions  = definitions or dict()
+
+    @property
+    def ssa_form(self):
+        return self
+
+    def get_ssa_var_definition(self, ssa_var):
+        return self.definitions.get(ssa_var)
+
+class Type(object):
+    def __init__(self, kind, name=None, children=(), members=None, width=0):
+        self.kind     = kind
+        self.name     = name
+        self.children = tuple(children)
+        self.members  = members
+        self.width    = width
+
+    def __len__(self):
+        # As binaryninja.Type, the width of the type (0 for void and functions)
+        return self.width
+
+    @property
+    def structure(self):
+        return self if self.members is not None else None
+
+    def __repr__(self):
+        if self.kind == "named":
+            return self.name
+        if self.kind == "pointer":
+            return f"{self.children[0]!r}*"
+        if self.kind == "array":
+            return f"{self.children[0]!r}[{self.name}]"
+        if self.kind == "function":
+            params = ", ".join(repr(t) for t in self.children[1:])
+            return f"{self.children[0]!r}({params})"
+        return self.name or self.kind
+
+    @staticmethod
+    def int(width, sign=True):
+        return Type("int", f"int{width * 8}_t", width=width)
+
+    @staticmethod
+    def char():
+        return Type("char", "char", width=1)
+
+    @staticmethod
+    def void():
+        return Type("void", "void")
+
+    @staticmethod
+    def array(element_type, count):
+        return Type("array", str(count), [element_type], width=len(element_type) * count)
+
+    @staticmethod
+    def pointer(arch, target):
+        return Type("pointer", None, [target], width=arch.address_size)
+
+    @staticmethod
+    def function(ret, params):
+        return Type("function", None, [ret] + list(params))
+
+    @staticmethod
+    def named_type_from_type(name, type_obj):
+        return Type("named", str(name), [type_obj], width=len(type_obj))
+
+class Symbol(object):
+    def __init__(self, sym_type, addr, name):
+        self.type    = sym_type
+        self.address = addr
+        self.name    = name
+
+class Arch(object):
+    def __init__(self, name, address_size, endianness):
+        self.name         = name
+        self.address_size = address_size
+        self.endianness   = endianness
+
+Architecture = {
+    "armv7":   Arch("armv7",   4, Endianness.LittleEndian),
+    "thumb2":  Arch("thumb2",  4, Endianness.LittleEndian),
+    "aarch64": Arch("aarch64", 8, Endianness.LittleEndian),
+    "x86":     Arch("x86",     4, Endianness.LittleEndian),
+    "x86_64":  Arch("x86_64",  8, Endianness.LittleEndian),
+    "mips32":  Arch("mips32",  4, Endianness.BigEndian)
+}
+
+class TypeParserResult(object):
+    def __init__(self, parsed_types):
+        self.types = parsed_types
+
+class MockPlatform(object):
+    def __init__(self, arch):
+        self.arch = arch
+        self.name = f"linux-{arch.name}"
+
+    def get_related_platform(self, arch):
+        return Platform[f"linux-{arch.name}"]
+
+    def parse_types_from_source(self, source):
+        # Not a C parser: collect the type names of jni.h, and the members of
+        # its function pointer tables (every member, and every typedef, is
+        # taken as pointer sized)
+        parsed = dict()
+        for name in re.findall(r"typedef\s[^;{]*?\b(\w+)\s*;", source):
+            parsed[name] = Type("typedef", name, width=self.arch.address_size)
+        for name in re.findall(r"}\s*(\w+)\s*;", source):
+            parsed[name] = Type("struct", name, members=list())
+        for name, body in re.findall(r"struct\s+(\w+)\s*{(.*?)\n};", source, re.S):
+            members = list()
+            for i, match in enumerate(re.finditer(r"\(\*\s*(\w+)\)|\b(reserved\d+)\s*;", body)):
+                members.append(types.SimpleNamespace(
+                    name=match.group(1) or match.group(2), offset=i * self.arch.address_size))
+            parsed[name] = Type("struct", name, members=members, width=len(members) * self.arch.address_size)
+        return TypeParserResult(parsed)
+
+Platform = {f"linux-{name}": MockPlatform(arch) for name, arch in Architecture.items()}
+
+class TypeLibrary(object):
+    def __init__(self, arch, name):
+        self.arch     = arch
+        self.name     = name
+        self.types    = dict()
+        self.metadata = dict()
+
+    @staticmethod
+    def new(arch, name):
+        return TypeLibrary(arch, name)
+
+    @staticmethod
+    def load_from_file(path):
+        with open(path, "rb") as fin:
+            return pickle.load(fin)
+
+    def add_platform(self, platform):
+        pass
+
+    def add_named_type(self, name, type_obj):
+        self.types[str(name)] = type_obj
+
+    def store_metadata(self, key, value):
+        self.metadata[key] = value
+
+    def query_metadata(self, key):
+        return self.metadata.get(key)
+
+    def finalize(self):
+        pass
+
+    def write_to_file(self, path):
+        with open(path, "wb") as fout:
+            pickle.dump(self, fout)
+
+class BackgroundTaskThread(object):
+    def __init__(self, initial_progress_text="", can_cancel=False):
+        self.progress = initial_progress_text
+
+    def start(self):
+        self.run()
+
+    def run(self):
+        pass
+
+class PluginCommand(object):
+    @staticmethod
+    def register(name, description, action, is_valid=None):
+        pass
+
+    register_for_address = register
+    register_for_range   = register
+
+interaction = types.SimpleNamespace(get_choice_input=lambda prompt, title, choices: None)
+
+_user_directory = None
+
+def user_directory():
+    global _user_directory
+    if _user_directory is None:
+        _user_directory = tempfile.mkdtemp(prefix="jni_bench_")
+    return _user_directory
+
+class Variable(object):
+    def __init__(self, var_type=None):
+        self.type = var_type
+
+class Function(object):
+    def __init__(self, view, start, platform):
+        self.view            = view
+        self.start           = start
+        self.platform        = platform
+        self.name            = f"sub_{start:x}"
+        self.return_type     = Type.int(4)
+        self.parameter_vars  = [Variable(), Variable(), Variable()]
+        self.type            = None
+        self.mlil            = None
+        self.callees         = list()
+        self.comments        = dict()
+
+    @property
+    def symbol(self):
+        return self.view.get_symbol_at(self.start)
+
+    def set_user_type(self, fun_type):
+        self.type = fun_type
+
+    def get_comment_at(self, addr):
+        return self.comments.get(addr, "")
+
+    def set_comment_at(self, addr, comment):
+        self.comments[addr] = comment
+
+class Segment(object):
+    def __init__(self, start, size, offset, file_size, flags):
+        self.start        = start
+        self.end          = start + size
+        self.data_offset  = offset
+        self.data_length  = file_size
+        self.readable     = bool(flags & 4)
+        self.writable     = bool(flags & 2)
+        self.executable   = bool(flags & 1)
+
+class Section(object):
+    def __init__(self, name, start, size, semantics):
+        self.name      = name
+        self.start     = start
+        self.end       = start + size
+        self.semantics = semantics
+
+class RawView(object):
+    def __init__(self, data):
+        self.data  = data
+        self.start = 0
+        self.end   = len(data)
+
+    def read(self, addr, length):
+        return self.data[addr:addr + length]
+
+class MockBinaryView(object):
+    ELF_MACHINES = {
+        40:  "armv7",
+        183: "aarch64",
+        3:   "x86",
+        62:  "x86_64",
+        8:   "mips32"
+    }
+
+    def __init__(self, data, filename="<memory>"):
+        self.raw      = RawView(data)
+        self.file     = types.SimpleNamespace(raw=self.raw, filename=filename, close=lambda: None)
+        self.segments = list()
+        self.sections = dict()
+        self.symbols  = dict()
+        self.types    = dict()
+        self.symbols_by_addr = dict()
+        self.metadata = dict()
+
+        self.data_vars       = dict()
+        self.type_libraries  = list()
+        self.functions_by_addr = dict()
+        self.n_reads         = 0
+        self.n_analysis_waits = 0
+        self._parse_elf(data)
+
+    @staticmethod
+    def load(path):
+        with open(path, "rb") as fin:
+            return MockBinaryView(fin.read(), path)
+
+    def _parse_elf(self, data):
+        if data[:4] != b"\x7fELF":
+            raise ValueError("not an ELF file")
+        bits   = 32 if data[4] == 1 else 64
+        endian = "<" if data[5] == 1 else ">"
+
+        if bits == 32:
+            (_, machine, _, _, phoff, shoff, _, _, phentsize, phnum, shentsize, shnum, shstrndx) = \
+                struct.unpack_from(endian + "HHIIIIIHHHHHH", data, 16)
+        else:
+            (_, machine, _, _, phoff, shoff, _, _, phentsize, phnum, shentsize, shnum, shstrndx) = \
+                struct.unpack_from(endian + "HHIQQQIHHHHHH", data, 16)
+
+        self.arch     = Architecture[self.ELF_MACHINES[machine]]
+        self.platform = Platform[f"linux-{self.arch.name}"]
+
+        for i in range(phnum):
+            if bits == 32:
+                p_type, offset, vaddr, _, filesz, memsz, flags, _ = \
+                    struct.unpack_from(endian + "8I", data, phoff + i * phentsize)
+            else:
+                p_type, flags, offset, vaddr, _, filesz, memsz, _ = \
+                    struct.unpack_from(endian + "IIQQQQQQ", data, phoff + i * phentsize)
+            if p_type == 1:
+                self.segments.append(Segment(vaddr, memsz, offset, filesz, flags))
+        self.segments.sort(key=lambda s: s.start)
+
+        headers = list()
+        for i in range(shnum):
+            if bits == 32:
+                header = struct.unpack_from(endian + "10I", data, shoff + i * shentsize)
+            else:
+                header = struct.unpack_from(endian + "IIQQQQIIQQ", data, shoff + i * shentsize)
+            headers.append(header)
+
+        def c_string(offset):
+            return data[offset:data.index(b"\x00", offset)].decode("ascii")
+
+        shstrtab_offset = headers[shstrndx][4]
+        for name_off, sh_type, flags, addr, offset, size, link, _, _, entsize in headers[1:]:
+            name = c_string(shstrtab_offset + name_off)
+            if flags & 0x2:
+                if flags & 0x4:
+                    semantics = SectionSemantics.ReadOnlyCodeSectionSemantics
+                elif flags & 0x1:
+                    semantics = SectionSemantics.ReadWriteDataSectionSemantics
+                else:
+                    semantics = SectionSemantics.ReadOnlyDataSectionSemantics
+                self.sections[name] = Section(name, addr, size, semantics)
+
+            if sh_type == 11:
+                # .dynsym: FUNC symbols become functions
+                strtab_offset = headers[link][4]
+                for sym_offset in range(offset + entsize, offset + size, entsize):
+                    if bits == 32:
+                        st_name, value, _, info, _, _ = struct.unpack_from(endian + "IIIBBH", data, sym_offset)
+                    else:
+                        st_name, info, _, _, value, _ = struct.unpack_from(endian + "IBBHQQ", data, sym_offset)
+                    if info & 0xf != 2:
+                        continue
+
+                    platform = self.platform
+                    if self.arch.name == "armv7" and value & 1:
+                        platform = Platform["linux-thumb2"]
+                        value   -= 1
+                    fun_name = c_string(strtab_offset + st_name)
+                    self.functions_by_addr[value] = Function(self, value, platform)
+                    self.define_user_symbol(Symbol(SymbolType.FunctionSymbol, value, fun_name))
+
+        self.start = self.segments[0].start if len(self.segments) > 0 else 0
+        self.end   = self.segments[-1].end if len(self.segments) > 0 else 0
+
+    def read(self, addr, length):
+        self.n_reads += 1
+        out = bytearray()
+        for segment in self.segments:
+            if length == 0:
+                break
+            if not segment.start <= addr < segment.end:
+                continue
+
+            n      = min(length, segment.end - addr)
+            offset = addr - segment.start
+            chunk  = self.raw.data[segment.data_offset + offset:
+                                   segment.data_offset + min(offset + n, segment.data_length)]
+            out   += chunk + bytes(n - len(chunk))
+            addr  += n
+            length -= n
+        return bytes(out)
+
+    @property
+    def functions(self):
+        return list(self.functions_by_addr.values())
+
+    def get_functions_at(self, addr):
+        fun = self.functions_by_addr.get(addr)
+        return [fun] if fun is not None else []
+
+    def create_user_function(self, addr, plat=None):
+        if addr not in self.functions_by_addr:
+            self.functions_by_addr[addr] = Function(self, addr, plat or self.platform)
+        return self.functions_by_addr[addr]
+
+    def get_symbol_at(self, addr):
+        return self.symbols_by_addr.get(addr)
+
+    def get_sections_at(self, addr):
+        return [s for s in self.sections.values() if s.start <= addr < s.end]
+
+    def define_user_symbol(self, sym):
+        self.symbols.setdefault(sym.name, list()).append(sym)
+        self.symbols_by_addr[sym.address] = sym
+        if sym.type == SymbolType.FunctionSymbol and sym.address in self.functions_by_addr:
+            self.functions_by_addr[sym.address].name = sym.name
+
+    def define_user_data_var(self, addr, var_type):
+        self.data_vars[addr] = var_type
+
+    def add_type_library(self, lib):
+        self.type_libraries.append(lib)
+
+    def import_library_type(self, name, lib):
+        type_obj = lib.types.get(str(name))
+        if type_obj is not None:
+            self.types[str(name)] = type_obj
+        return type_obj
+
+    def store_metadata(self, key, value):
+        self.metadata[key] = value
+
+    def query_metadata(self, key):
+        return self.metadata[key]
+
+    def begin_undo_actions(self):
+        return None
+
+    def commit_undo_actions(self, state=None):
+        pass
+
+    def set_analysis_hold(self, enable):
+        pass
+
+    def update_analysis_and_wait(self):
+        self.n_analysis_waits += 1
+
+def load(path, update_analysis=True, options=None):
+    return MockBinaryView.load(path)
+
+def install():
+    # Register this module as "binaryninja"
+    sys.modules["binaryninja"] = sys.modules[__name__]
@@ -0,0 +1,256 @@
+"""
+Headless benchmark of FindJNIFunctionAnalysis.
+
+Generates synthetic ELF fixtures (see synth_elf), loads them in the mock
+BinaryView of mock_binaryninja, runs the analysis and reports the time spent
+in every phase, the throughput of the dynamic scan, whether all the
+JNINativeMethod entries and Java_* methods were found and whether the methods
+of a "(...)V" signature were typed as returning void. The "traced"
+configurations give the fixture the MLIL of a RegisterNatives helper (see
+add_register_natives_il), whose tables must be found by tracing.
+
+    python3 bench/run_bench.py [--size MB] [--arch armv7,x86_64] [--workers N]
+                               [--window-size MB] [--cache] [--json]
+                               [--min-throughput MBPS]
+"""
+
+import os
+import sys
+import json
+import time
+import argparse
+import contextlib
+import tempfile
+import importlib.util
+
+BENCHDIR  = os.path.dirname(os.path.realpath(__file__))
+PLUGINDIR = os.path.dirname(BENCHDIR)
+sys.path.insert(0, BENCHDIR)
+
+import synth_elf
+import mock_binaryninja
+
+# Methods of FindJNIFunctionAnalysis timed by the benchmark
+PHASES = (
+    "define_JNI_types",
+    "find_dynamic_jni",
+    "find_static_jni",
+    "commit_changes",
+    "apply_types"
+)
+
+# (name, synth_elf.generate arguments, FindJNIFunctionAnalysis arguments, traced)
+CONFIGS = (
+    ("armv7-thumb",      {"arch": "armv7", "thumb": True},      {},                  False),
+    ("aarch64",          {"arch": "aarch64"},                   {},                  False),
+    ("aarch64-traced",   {"arch": "aarch64", "seed": 1},        {},                  True),
+    ("x86",              {"arch": "x86"},                       {},                  False),
+    ("x86_64",           {"arch": "x86_64"},                    {},                  False),
+    ("mips32",           {"arch": "mips32"},                    {},                  False),
+    ("x86_64-unaligned", {"arch": "x86_64", "unaligned": True}, {"unaligned": True}, False)
+)
+
+def load_plugin():
+    # Import the plugin package against the mock binaryninja module
+    mock_binaryninja.install()
+    spec = importlib.util.spec_from_file_location("jni_plugin",
+        os.path.join(PLUGINDIR, "__init__.py"), submodule_search_locations=[PLUGINDIR])
+    plugin = importlib.util.module_from_spec(spec)
+    sys.modules["jni_plugin"] = plugin
+    spec.loader.exec_module(plugin)
+    return plugin
+
+def add_register_natives_il(plugin, bv, fixture):
+    # Give bv the MLIL of the usual registration code: JNI_OnLoad calls
+    # register_natives(env), which passes every table of fixture to
+    # register_native_methods(env, class_name, methods, n_methods), calling the
+    # imported __android_log_print and (*env)->RegisterNatives(env, cls, methods, n_methods)
+    Op, RV = mock_binaryninja.MediumLevelILOperation, mock_binaryninja.RegisterValueType
+
+    library  = plugin.jni_types.load_type_library(bv.platform)
+    slots    = plugin.jni_calls.get_vtable_slots(library.types["JNINativeInterface"])
+    register = next(offset for offset, name in slots.items() if name == "RegisterNatives")
+
+    def const(value):
+        return mock_binaryninja.MediumLevelILInstruction(Op.MLIL_CONST,
+            mock_binaryninja.RegisterValue(RV.ConstantPointerValue, value), constant=value)
+
+    def var(ssa_var):
+        return mock_binaryninja.MediumLevelILInstruction(Op.MLIL_VAR_SSA, src=ssa_var)
+
+    def local():
+        return var(mock_binaryninja.SSAVariable(mock_binaryninja.Variable(), 1))
+
+    def call(fun, i, dest, params):
+        return mock_binaryninja.MediumLevelILInstruction(Op.MLIL_CALL_SSA,
+            address=fun.start + i * 4, dest=dest, params=params)
+
+    jni_onload              = bv.get_functions_at(bv.symbols["JNI_OnLoad"][0].address)[0]
+    register_natives        = bv.create_user_function(jni_onload.start + 0x10)
+    register_native_methods = bv.create_user_function(jni_onload.start + 0x20)
+    android_log_print       = bv.create_user_function(jni_onload.start + 0x30)
+    bv.define_user_symbol(mock_binaryninja.Symbol(mock_binaryninja.SymbolType.ImportedFunctionSymbol,
+        android_log_print.start, "__android_log_print"))
+
+    register_native_methods.parameter_vars = [mock_binaryninja.Variable() for _ in range(4)]
+    params = [var(mock_binaryninja.SSAVariable(v, 0)) for v in register_native_methods.parameter_vars]
+    register_native_methods.mlil = mock_binaryninja.MediumLevelILFunction([
+        call(register_native_methods, 0, const(android_log_print.start), [const(4), params[1]]),
+        call(register_native_methods, 1,
+            mock_binaryninja.MediumLevelILInstruction(Op.MLIL_LOAD_STRUCT_SSA, src=params[0], offset=register),
+            [params[0], local(), params[2], params[3]])
+    ])
+    register_native_methods.callees = [android_log_print]
+
+    env = local()
+    register_natives.mlil = mock_binaryninja.MediumLevelILFunction([
+        call(register_natives, i, const(register_native_methods.start), [env, const(0), const(addr), const(n)])
+        for i, (addr, n) in enumerate(fixture.tables)
+    ])
+    register_natives.callees = [register_native_methods]
+
+    jni_onload.mlil = mock_binaryninja.MediumLevelILFunction([
+        call(jni_onload, 0, const(register_natives.start), [local()])
+    ])
+    jni_onload.callees = [register_natives]
+
+def time_phases(analysis):
+    # Wrap the phase methods of analysis, accumulating their wall time
+    timings = {phase: 0.0 for phase in PHASES}
+
+    def timed(phase, method):
+        def wrapper(*args, **kwargs):
+            start = time.perf_counter()
+            try:
+                return method(*args, **kwargs)
+            finally:
+                timings[phase] += time.perf_counter() - start
+        return wrapper
+
+    for phase in PHASES:
+        setattr(analysis, phase, timed(phase, getattr(analysis, phase)))
+    return timings
+
+def run_config(plugin, name, fixture, path, analysis_args, traced, workers, use_cache):
+    bv = mock_binaryninja.MockBinaryView.load(path)
+    if traced:
+        add_register_natives_il(plugin, bv, fixture)
+
+    analysis = plugin.FindJNIFunctionAnalysis(bv, workers=workers, use_cache=use_cache, **analysis_args)
+    timings  = time_phases(analysis)
+    start    = time.perf_counter()
+    analysis.run()
+    total    = time.perf_counter() - start
+
+    # Entries expected in the tables vs JNINativeMethod data vars defined
+    entry_size = 3 * bv.arch.address_size
+    expected   = {
+        addr + i * entry_size for addr, n_entries in fixture.tables for i in range(n_entries)
+    }
+    found = {
+        addr for addr, var_type in bv.data_vars.items() if repr(var_type) == "JNINativeMethod"
+    }
+    static_names = {fun.name for fun in analysis.jni_functions}
+
+    # Methods with a "(...)V" signature must be typed as returning void
+    void_functions = [
+        fun for fun in analysis.jni_functions
+        if (analysis.jni_methods.get(fun.start, (None, None, None))[2] or "").endswith(")V")
+    ]
+    void_wrong = sum(1 for fun in void_functions if not repr(fun.type).startswith("void("))
+
+    scan_time = timings["find_dynamic_jni"]
+    return {
+        "config":           name,
+        "data_mb":          fixture.data_size / 0x100000,
+        "timings":          timings,
+        "total":            total,
+        "scan_mb_s":        fixture.data_size / 0x100000 / scan_time if scan_time > 0 and not traced else None,
+        "entries_expected": len(expected),
+        "entries_missing":  len(expected - found),
+        "entries_extra":    len(found - expected),
+        "static_missing":   len(set(fixture.static_methods) - static_names),
+        "void_methods":     len(void_functions),
+        "void_wrong":       void_wrong,
+        "traced":           traced,
+        "methods_traced":   analysis.stats.counters["methods_traced"],
+        "methods_cached":   analysis.stats.counters["methods_cached"],
+        "reads":            bv.n_reads,
+        "analysis_waits":   bv.n_analysis_waits,
+        "stats":            analysis.stats.as_dict()
+    }
+
+def print_result(result):
+    timings = ", ".join("%s %.3fs" % (phase, t) for phase, t in result["timings"].items())
+    print("%-18s %7.1f MB  scan %8.1f MB/s  total %.3fs" % (
+        result["config"], result["data_mb"], result["scan_mb_s"] or 0.0, result["total"]))
+    print("%-18s %s" % ("", timings))
+    print("%-18s entries %d (missing %d, extra %d), static missing %d, reads %d, analysis waits %d" % (
+        "", result["entries_expected"], result["entries_missing"], result["entries_extra"],
+        result["static_missing"], result["reads"], result["analysis_waits"]))
+    print("%-18s void methods %d (wrong return type %d), traced %d" % (
+        "", result["void_methods"], result["void_wrong"], result["methods_traced"]))
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark FindJNIFunctionAnalysis on synthetic ELF files")
+    parser.add_argument("--size", type=float, default=16, help="size of the data section in MB")
+    parser.add_argument("--tables", type=int, default=64, help="JNINativeMethod tables per fixture")
+    parser.add_argument("--methods", type=int, default=16, help="entries per table")
+    parser.add_argument("--arch", default=None, help="comma separated configurations to run")
+    parser.add_argument("--workers", type=int, default=None, help="scan workers")
+    parser.add_argument("--window-size", type=float, default=None, help="scan window size in MB")
+    parser.add_argument("--cache", action="store_true", help="run twice, with a cold and a warm result cache")
+    parser.add_argument("--json", action="store_true", help="print the results as JSON")
+    parser.add_argument("--min-throughput", type=float, default=None,
+        help="fail if the scan throughput of a configuration is below this many MB/s")
+    args = parser.parse_args()
+
+    plugin  = load_plugin()
+    configs = CONFIGS
+    if args.arch is not None:
+        selected = set(args.arch.split(","))
+        configs  = [config for config in CONFIGS if config[0] in selected or config[1]["arch"] in selected]
+
+    results = list()
+    with tempfile.TemporaryDirectory(prefix="jni_bench_") as tmp_dir:
+        for name, fixture_args, analysis_args, traced in configs:
+            if args.window_size is not None:
+                analysis_args = dict(analysis_args, window_size=int(args.window_size * 0x100000))
+            fixture = synth_elf.generate(data_size=int(args.size * 0x100000), n_tables=args.tables,
+                methods_per_table=args.methods, **fixture_args)
+            path = os.path.join(tmp_dir, f"{name}.so")
+            fixture.write(path)
+
+            for run in range(2 if args.cache else 1):
+                # Keep stdout for the JSON report
+                with contextlib.redirect_stdout(sys.stderr if args.json else sys.stdout):
+                    result = run_config(plugin, name, fixture, path, analysis_args, traced,
+                        args.workers, args.cache)
+                if args.cache:
+                    result["config"] += " (warm)" if run > 0 else " (cold)"
+                results.append(result)
+                if not args.json:
+                    print_result(result)
+
+    if args.json:
+        print(json.dumps(results, indent=2))
+
+    failed = False
+    for result in results:
+        if result["entries_missing"] > 0 or result["static_missing"] > 0:
+            print(f"[!] {result['config']}: JNI methods not found", file=sys.stderr)
+            failed = True
+        if result["void_methods"] == 0 or result["void_wrong"] > 0:
+            print(f"[!] {result['config']}: void methods not typed as returning void", file=sys.stderr)
+            failed = True
+        if result["traced"] and result["methods_traced"] + result["methods_cached"] != result["entries_expected"]:
+            print(f"[!] {result['config']}: JNI methods not traced from the RegisterNatives calls", file=sys.stderr)
+            failed = True
+        if args.min_throughput is not None and result["scan_mb_s"] is not None and \
+                result["scan_mb_s"] < args.min_throughput:
+            print(f"[!] {result['config']}: scan throughput below {args.min_throughput} MB/s", file=sys.stderr)
+            failed = True
+    return 1 if failed else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
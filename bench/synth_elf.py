@@ -0,0 +1,253 @@
+"""
+Generation of synthetic ELF shared objects embedding JNINativeMethod tables,
+used as fixtures by the benchmark.
+
+The generated objects have three PT_LOAD segments (.text, .rodata and
+.data.rel.ro) and a .dynsym exporting JNI_OnLoad and the statically
+registered Java_* methods. .data.rel.ro is filled with noise (zeros, random
+words, pointers into .text and .rodata) around the JNINativeMethod tables.
+"""
+
+import random
+import struct
+
+PAGE_SIZE = 0x1000
+
+# The noise of the data section is made of NOISE_BLOCK_SIZE slices of a pool of random words
+NOISE_POOL_SIZE  = 0x40000
+NOISE_BLOCK_SIZE = 0x1000
+
+# name -> (ELF class bits, little endian, e_machine)
+ARCHS = {
+    "armv7":   (32, True,  40),
+    "aarch64": (64, True,  183),
+    "x86":     (32, True,  3),
+    "x86_64":  (64, True,  62),
+    "mips32":  (32, False, 8)
+}
+
+SHT_PROGBITS = 1
+SHT_STRTAB   = 3
+SHT_DYNSYM   = 11
+
+SHF_WRITE     = 0x1
+SHF_ALLOC     = 0x2
+SHF_EXECINSTR = 0x4
+
+PT_LOAD = 1
+PF_X    = 0x1
+PF_W    = 0x2
+PF_R    = 0x4
+
+STT_FUNC   = 2
+STB_GLOBAL = 1
+
+SIGNATURES = [
+    "()V",
+    "()I",
+    "(I)V",
+    "(J)J",
+    "(Ljava/lang/String;)V",
+    "(Ljava/lang/String;)Ljava/lang/String;",
+    "([B)[B",
+    "(ILjava/lang/String;[B)J",
+    "(Landroid/content/Context;Ljava/lang/Object;)Z",
+    "([Ljava/lang/String;[[I)Ljava/lang/Class;"
+]
+
+class Fixture(object):
+    # A generated ELF and what the analysis is expected to find in it
+    def __init__(self, arch, data, data_size, tables, static_methods):
+        self.arch           = arch
+        self.data           = data
+        self.data_size      = data_size
+        self.tables         = tables
+        self.static_methods = static_methods
+
+    @property
+    def expected_entries(self):
+        return sum(n_entries for _, n_entries in self.tables)
+
+    def write(self, path):
+        with open(path, "wb") as fout:
+            fout.write(self.data)
+
+class _StringTable(object):
+    def __init__(self):
+        self.data    = bytearray(b"\x00")
+        self.offsets = dict()
+
+    def add(self, s):
+        if s not in self.offsets:
+            self.offsets[s] = len(self.data)
+            self.data      += s.encode("ascii") + b"\x00"
+        return self.offsets[s]
+
+def _align(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+def generate(arch="aarch64", data_size=0x100000, n_tables=32, methods_per_table=16,
+             n_static=64, unaligned=False, thumb=False, seed=0):
+    # Generate a Fixture for arch. With unaligned, the tables are placed at
+    # offsets that are not pointer-aligned. With thumb (armv7 only) the method
+    # pointers have the low bit set
+    bits, little_endian, machine = ARCHS[arch]
+    rnd          = random.Random(seed)
+    address_size = bits // 8
+    endian       = "<" if little_endian else ">"
+    word_fmt     = endian + ("I" if address_size == 4 else "Q")
+    entry_size   = 3 * address_size
+
+    # .text: JNI_OnLoad, the static methods and the targets of the tables
+    n_functions = 1 + n_static + n_tables * methods_per_table
+    text_size   = _align(n_functions * 0x40, PAGE_SIZE)
+    text        = bytes(rnd.getrandbits(8) for _ in range(text_size))
+
+    # .rodata: names and signatures, shared between the tables as in real libraries
+    rodata = _StringTable()
+    rodata.add("noise")
+    for signature in SIGNATURES:
+        rodata.add(signature)
+
+    ehdr_size  = 52 if bits == 32 else 64
+    phdr_size  = 32 if bits == 32 else 56
+    text_off   = _align(ehdr_size + 3 * phdr_size, PAGE_SIZE)
+    rodata_off = text_off + text_size
+
+    method_names = ["nativeMethod%d" % i for i in range(methods_per_table * 4)]
+    for name in method_names:
+        rodata.add(name)
+    rodata_size = _align(len(rodata.data), PAGE_SIZE)
+    data_off    = rodata_off + rodata_size
+    data_size   = _align(data_size, PAGE_SIZE)
+
+    def function_address(i):
+        return text_off + i * 0x40
+
+    # .data.rel.ro noise, copied from a pool of random words
+    pool = bytearray(NOISE_POOL_SIZE)
+    for offset in range(0, NOISE_POOL_SIZE, address_size):
+        r = rnd.random()
+        if r < 0.5:
+            continue
+        elif r < 0.7:
+            value = text_off + rnd.randrange(text_size)
+        elif r < 0.8:
+            value = rodata_off + rnd.randrange(len(rodata.data))
+        else:
+            value = rnd.getrandbits(bits)
+        struct.pack_into(word_fmt, pool, offset, value)
+
+    data = bytearray(data_size)
+    for offset in range(0, data_size, NOISE_BLOCK_SIZE):
+        pool_offset = rnd.randrange(0, NOISE_POOL_SIZE - NOISE_BLOCK_SIZE, address_size)
+        data[offset:offset + NOISE_BLOCK_SIZE] = pool[pool_offset:pool_offset + NOISE_BLOCK_SIZE]
+
+    # The tables, in disjoint slots of the section
+    tables     = list()
+    table_size = methods_per_table * entry_size
+    slot_size  = data_size // max(n_tables, 1)
+    if slot_size < table_size + 2 * address_size:
+        raise ValueError("data_size too small for the requested tables")
+    for t in range(n_tables):
+        slot_start = t * slot_size
+        offset     = slot_start + rnd.randrange(0, slot_size - table_size - address_size) \
+                     // address_size * address_size
+        if unaligned:
+            offset += rnd.randrange(1, address_size)
+
+        for m in range(methods_per_table):
+            name       = rodata.offsets[rnd.choice(method_names)] + rodata_off
+            signature  = rodata.offsets[rnd.choice(SIGNATURES)] + rodata_off
+            method_ptr = function_address(1 + n_static + t * methods_per_table + m)
+            if thumb:
+                method_ptr |= 1
+            struct.pack_into(endian + word_fmt[1] * 3, data, offset + m * entry_size,
+                name, signature, method_ptr)
+        tables.append((data_off + offset, methods_per_table))
+
+    # .dynsym / .dynstr (not allocated, the mock view reads them from the file)
+    dynstr         = _StringTable()
+    symbols        = [("JNI_OnLoad", function_address(0))]
+    static_methods = list()
+    for i in range(n_static):
+        name = "Java_com_example_app%d_Native%d_method%d" % (i % 3, i % 7, i)
+        if i % 4 == 0:
+            name += "__ILjava_lang_String_2"
+        symbols.append((name, function_address(1 + i)))
+        static_methods.append(name)
+
+    sym_size = 16 if bits == 32 else 24
+    dynsym   = bytearray(sym_size)
+    for name, address in symbols:
+        name_off = dynstr.add(name)
+        info     = (STB_GLOBAL << 4) | STT_FUNC
+        if thumb:
+            address |= 1
+        if bits == 32:
+            dynsym += struct.pack(endian + "IIIBBH", name_off, address, 0x40, info, 0, 1)
+        else:
+            dynsym += struct.pack(endian + "IBBHQQ", name_off, info, 0, 1, address, 0x40)
+
+    dynsym_off = data_off + data_size
+    dynstr_off = dynsym_off + len(dynsym)
+    sections   = [
+        # name, type, flags, offset, size, link, entsize
+        (".text",        SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_off,   text_size,        0, 0),
+        (".rodata",      SHT_PROGBITS, SHF_ALLOC,                 rodata_off, rodata_size,      0, 0),
+        (".data.rel.ro", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,     data_off,   data_size,        0, 0),
+        (".dynsym",      SHT_DYNSYM,   0,                         dynsym_off, len(dynsym),      5, sym_size),
+        (".dynstr",      SHT_STRTAB,   0,                         dynstr_off, len(dynstr.data), 0, 0),
+    ]
+
+    shstrtab = _StringTable()
+    for section in sections:
+        shstrtab.add(section[0])
+    shstrtab.add(".shstrtab")
+    shstrtab_off = dynstr_off + len(dynstr.data)
+    sections.append((".shstrtab", SHT_STRTAB, 0, shstrtab_off, len(shstrtab.data), 0, 0))
+    shdr_off = _align(shstrtab_off + len(shstrtab.data), 8)
+
+    out = bytearray(shdr_off)
+    out[text_off:text_off + text_size]                   = text
+    out[rodata_off:rodata_off + len(rodata.data)]        = rodata.data
+    out[data_off:data_off + data_size]                   = data
+    out[dynsym_off:dynsym_off + len(dynsym)]             = dynsym
+    out[dynstr_off:dynstr_off + len(dynstr.data)]        = dynstr.data
+    out[shstrtab_off:shstrtab_off + len(shstrtab.data)]  = shstrtab.data
+
+    # Section headers, after the SHN_UNDEF one
+    out += bytes(40 if bits == 32 else 64)
+    for name, sh_type, flags, offset, size, link, entsize in sections:
+        addr = offset if flags & SHF_ALLOC else 0
+        info = 1 if sh_type == SHT_DYNSYM else 0
+        if bits == 32:
+            out += struct.pack(endian + "10I", shstrtab.offsets[name], sh_type, flags, addr,
+                offset, size, link, info, 1, entsize)
+        else:
+            out += struct.pack(endian + "IIQQQQIIQQ", shstrtab.offsets[name], sh_type, flags, addr,
+                offset, size, link, info, 1, entsize)
+
+    # ELF header and program headers
+    segments = [
+        (text_off,   text_size,   PF_R | PF_X),
+        (rodata_off, rodata_size, PF_R),
+        (data_off,   data_size,   PF_R | PF_W)
+    ]
+    ident = b"\x7fELF" + bytes([1 if bits == 32 else 2, 1 if little_endian else 2, 1]) + bytes(9)
+    if bits == 32:
+        header = ident + struct.pack(endian + "HHIIIIIHHHHHH", 3, machine, 1, 0, ehdr_size,
+            shdr_off, 0, ehdr_size, phdr_size, len(segments), 40, len(sections) + 1, len(sections))
+    else:
+        header = ident + struct.pack(endian + "HHIQQQIHHHHHH", 3, machine, 1, 0, ehdr_size,
+            shdr_off, 0, ehdr_size, phdr_size, len(segments), 64, len(sections) + 1, len(sections))
+
+    phdrs = b""
+    for offset, size, flags in segments:
+        if bits == 32:
+            phdrs += struct.pack(endian + "8I", PT_LOAD, offset, offset, offset, size, size, flags, PAGE_SIZE)
+        else:
+            phdrs += struct.pack(endian + "IIQQQQQQ", PT_LOAD, flags, offset, offset, offset, size, size, PAGE_SIZE)
+    out[0:len(header) + len(phdrs)] = header + phdrs
+
+    return Fixture(arch, bytes(out), data_size, tables, static_methods)
@@ -1,23 +1,139 @@
 import sys
 import os
+import bisect
+import collections
 
 from binaryninja import (
     SymbolType, Endianness, Type, BackgroundTaskThread,
-    Symbol, SymbolType, Architecture, SectionSemantics)
+    Symbol, SymbolType, Architecture, SectionSemantics,
+    user_directory)
+
+from .jni_stats import AnalysisStats
+from .jni_cache import ResultCache, BlockHasher, ScannedIntervals, hash_view, get_digest, iter_block_parts
+from .jni_types import load_type_library
+from .jni_names import JNI_STATIC_PREFIX, demangle_jni_name, parse_method_descriptor
+from .jni_calls import get_vtable_slots, iter_vtable_calls, get_reachable_functions, resolve_arguments
+from .jni_scanner import IntervalIndex, scan_chunk, scan_overlap, make_executor, unpack_words
 
-SCRIPTDIR  = os.path.dirname(os.path.realpath(__file__))
 JNI_ONLOAD = "JNI_OnLoad"
 
+# Types imported from the JNI type library up front, the others are imported on demand
+JNI_TYPE_NAMES = ("JNIEnv", "JavaVM", "JNINativeMethod")
+
+# Cached results are keyed by the plugin version as well, bump it when the analysis changes
+PLUGIN_VERSION = "1.1.0"
+CACHE_DIRNAME  = "jni_cache"
+
+# JNINativeMethod is { const char* name; const char* signature; void* fnPtr; }
+JNI_NATIVE_METHOD_WORDS = 3
+
+# Strings are read in chunks of STRING_CHUNK_SIZE bytes, up to STRING_MAX_LENGTH
+STRING_CHUNK_SIZE = 64
+STRING_MAX_LENGTH = 1024
+
+# Data sections are streamed in windows of SCAN_WINDOW_SIZE bytes by default, with
+# at most SCAN_WINDOWS_PER_WORKER windows per worker read ahead of the validation,
+# and no more than SCAN_MAX_PENDING_SIZE bytes of them whatever the number of workers
+SCAN_WINDOW_SIZE        = 0x400000
+SCAN_WINDOWS_PER_WORKER = 2
+SCAN_MAX_PENDING_SIZE   = 0x4000000
+
+# Counters of the slots rejected by the checks of the pre-filter (see scan_chunk), in
+# their order. The same checks are counted by validate_candidates on the candidates
+PREFILTER_COUNTERS = ("rejected_code_pointer", "rejected_name_pointer", "rejected_signature")
+
+# Granularity at which the scanned regions are tracked in the view metadata, the
+# parts of a block scanned are tracked as well
+REGION_BLOCK_SIZE       = 0x10000
+SCANNED_BLOCKS_METADATA = "jni_scanned_blocks"
+
+# RegisterNatives calls are looked for up to TRACE_MAX_DEPTH calls away from
+# JNI_OnLoad, in tables of at most TRACE_MAX_METHODS entries
+TRACE_MAX_DEPTH   = 2
+TRACE_MAX_METHODS = 0x1000
+
+# Types through which the JNIEnv function table is reached once the parameters
+# are typed (JNIEnv is a pointer to JNINativeInterface)
+JNI_ENV_TYPE_NAMES = ("JNIEnv", "JNINativeInterface")
+
+# Indexes of the string arguments of the JNIEnv functions, extracted at the call sites
+JNI_ENV_STRING_ARGS = {
+    "FindClass":         (1, ),
+    "GetMethodID":       (2, 3),
+    "GetStaticMethodID": (2, 3),
+    "GetFieldID":        (2, 3),
+    "GetStaticFieldID":  (2, 3),
+    "NewStringUTF":      (1, ),
+    "ThrowNew":          (2, )
+}
+
+# JNIEnv function name -> [[function, call address, string arguments], ...]
+ENV_CALLS_METADATA = "jni_env_calls"
+
 def print_err(msg):
     sys.stderr.write(f"{msg}\n")
 
+def format_env_call(slot_name, strings):
+    # e.g. GetMethodID("<init>", "(I)V"), unresolved arguments are shown as ?
+    if len(strings) == 0:
+        return slot_name
+    return "%s(%s)" % (slot_name, ", ".join("?" if not s else f"\"{s}\"" for s in strings))
+
+def query_env_calls(bv, slot_name=None):
+    # Calls through the JNIEnv function table found by the last analysis of
+    # bv: the list of (function, call address, string arguments) of slot_name,
+    # or the dict of all of them by JNIEnv function name. Unresolved string
+    # arguments are empty
+    try:
+        env_calls = dict(bv.query_metadata(ENV_CALLS_METADATA))
+    except KeyError:
+        env_calls = dict()
+
+    env_calls = {
+        name: [(fun_addr, call_addr, list(strings)) for fun_addr, call_addr, strings in calls]
+        for name, calls in env_calls.items()
+    }
+    if slot_name is not None:
+        return env_calls.get(slot_name, list())
+    return env_calls
+
 class FindJNIFunctionAnalysis(BackgroundTaskThread):
-    def __init__(self, bv):
+    def __init__(self, bv, unaligned=False, workers=None, use_cache=True, regions=None, trace=True,
+                 stats_json=None, window_size=SCAN_WINDOW_SIZE):
         BackgroundTaskThread.__init__(self, "Finding JNI Functions", False)
         self.bv = bv
 
+        # Progress, counters and timings of the phases, written to stats_json (if set) by run
+        self.stats      = AnalysisStats(lambda text: setattr(self, "progress", text), "Finding JNI Functions")
+        self.stats_json = stats_json
+
+        # JNINativeMethod tables are pointer-aligned, scan every byte offset only on request
+        self.unaligned = unaligned
+        self.workers   = workers or os.cpu_count() or 1
+        # Bytes of a data section read at once, the memory of the scan does not depend on the section sizes
+        self.window_size = window_size
+        self.use_cache = use_cache
+        # Restrict the dynamic scan to these section names / (start, end) ranges
+        self.regions   = regions
+        # Locate the tables from the RegisterNatives calls before falling back to the scan
+        self.trace     = trace
+
         self.jni_functions = list()
         self.jni_onload = None
+        # Function address -> (class name, method name, signature), where known
+        self.jni_methods = dict()
+        self.typed_functions = set()
+        # JNI signature -> (parameter types, return type), see get_method_type
+        self.method_types = dict()
+        self.string_cache = dict()
+        self.jni_types = dict()
+        self.jni_type_defs = dict()
+        self.jni_type_library = None
+        self.method_entries = list()
+        self.pending_changes = list()
+        # Offset -> name of the JNIEnv functions, and the calls to them by name (see resolve_env_calls)
+        self.env_slots = None
+        self.env_calls = dict()
 
         self.code_sections = list()
         self.data_sections = list()
@@ -36,36 +152,74 @@ class FindJNIFunctionAnalysis(BackgroundTaskThread):
             }:
                 self.data_sections.append((s_name, s.start, s.end))
 
-    def update_progress(self, phase_name, curr, total):
-        self.progress = f"Finding JNI Functions ({phase_name}): {curr} / {total}"
+        # Interval indexes answering "is this a pointer to code / to mapped memory"
+        self.code_index   = IntervalIndex((begin, end) for _, begin, end in self.code_sections)
+        self.mapped_index = IntervalIndex((s.start, s.end) for s in self.bv.segments if s.readable)
+
+    def queue_change(self, fun, *args):
+        self.pending_changes.append((fun, args))
+
+    def commit_changes(self, phase_name, reanalyze=True):
+        # Apply the queued changes in one batch: auto-analysis is held while they
+        # are applied, they form a single undo action and the view is reanalyzed
+        # once (unless the changes, e.g. comments, do not affect the analysis)
+        if len(self.pending_changes) == 0:
+            return
+
+        undo_state = self.bv.begin_undo_actions()
+        self.bv.set_analysis_hold(True)
+        try:
+            n_changes = len(self.pending_changes)
+            for i, (fun, args) in enumerate(self.pending_changes):
+                self.stats.progress(phase_name, i, n_changes)
+                fun(*args)
+        finally:
+            self.pending_changes = list()
+            self.bv.set_analysis_hold(False)
+            if undo_state is None:
+                self.bv.commit_undo_actions()
+            else:
+                self.bv.commit_undo_actions(undo_state)
+
+        if reanalyze:
+            self.bv.update_analysis_and_wait()
 
     def is_ptr_to_code(self, addr):
-        for _, begin, end in self.code_sections:
-            if begin <= addr < end:
-                return True
-        return False
+        return addr in self.code_index
 
     def is_pointer(self, addr):
-        return self.bv.read(addr, 1) != b""
-
-    def read_pointer(self, addr):
-        data = self.bv.read(addr, self.bv.arch.address_size)
-        value = int.from_bytes(data, 'little' if self.bv.arch.endianness == Endianness.LittleEndian else 'big')
-        return value
+        return addr in self.mapped_index
 
     def get_string(self, address):
-        i = 0
-        s = ""
-        s_ptr = address
-        while 1:
-            b = self.bv.read(s_ptr + i, 1)
-            if b == b"\x00":
+        # Method names and signatures are heavily shared between tables, so
+        # results (including failures) are memoized by address
+        if address in self.string_cache:
+            self.stats.count("string_cache_hits")
+            return self.string_cache[address]
+
+        s = self.read_string(address)
+        self.string_cache[address] = s
+        return s
+
+    def read_string(self, address):
+        self.stats.count("strings_decoded")
+        data = b""
+        while len(data) < STRING_MAX_LENGTH:
+            chunk = self.bv.read(address + len(data), STRING_CHUNK_SIZE)
+            end   = chunk.find(b"\x00")
+            if end != -1:
+                data += chunk[:end]
                 break
-            if b == b"" or not b.isascii():
+            if len(chunk) < STRING_CHUNK_SIZE:
+                # Unterminated string at the end of mapped memory
                 return None
-            s += b.decode("ascii")
-            i += 1
-        return s
+            data += chunk
+        else:
+            return None
+
+        if not data.isascii():
+            return None
+        return data.decode("ascii")
 
     def is_address_of_function(self, address, function):
         funcs = self.bv.get_functions_at(address)
@@ -75,15 +229,33 @@ class FindJNIFunctionAnalysis(BackgroundTaskThread):
         return False
 
     def define_JNI_types(self):
-        with open(os.path.join(SCRIPTDIR, "jni.h"), "r") as fin:
-            data = fin.read()
-
-        jni_types = self.bv.platform.parse_types_from_source(data)
-        for type_name in jni_types.types:
-            type_obj = jni_types.types[type_name]
-            self.bv.define_user_type(type_name, type_obj)
-
-    def find_dynamic_jni(self):
+        self.jni_type_library = load_type_library(self.bv.platform)
+        self.bv.add_type_library(self.jni_type_library)
+        for type_name in JNI_TYPE_NAMES:
+            self.get_jni_type(type_name)
+
+    def get_jni_type_definition(self, type_name):
+        # Import type_name (and the types it depends on) from the JNI type library
+        if type_name not in self.jni_type_defs:
+            type_obj = self.bv.import_library_type(type_name, self.jni_type_library)
+            if type_obj is None:
+                raise KeyError(f"\"{type_name}\" is not a JNI type")
+            self.jni_type_defs[type_name] = type_obj
+        return self.jni_type_defs[type_name]
+
+    def get_jni_type(self, type_name):
+        # Named reference to the JNI type type_name
+        if type_name not in self.jni_types:
+            type_obj = self.get_jni_type_definition(type_name)
+            self.jni_types[type_name] = Type.named_type_from_type(type_name, type_obj)
+        return self.jni_types[type_name]
+
+    def get_env_slots(self):
+        if self.env_slots is None:
+            self.env_slots = get_vtable_slots(self.get_jni_type_definition("JNINativeInterface"))
+        return self.env_slots
+
+    def find_jni_onload(self):
         if JNI_ONLOAD not in self.bv.symbols:
             print(f"[!] \"{JNI_ONLOAD}\" not in symbols")
         else:
@@ -95,70 +267,383 @@ class FindJNIFunctionAnalysis(BackgroundTaskThread):
                 if len(funcs) > 0:
                     self.jni_onload = funcs[0]
 
-        csec_i          = 0
-        n_data_sections = len(self.data_sections)
-        for section_name, start, end in self.data_sections:
-            csec_i += 1
-            caddr_i = 0
-            n_addresses = end - start
-            for addr in range(start, end):
-                caddr_i += 1
-                self.update_progress(
-                    " dynamic : sec \"%s\" %d/%d " % (section_name, csec_i, n_data_sections), caddr_i, n_addresses)
-
-                if not self.is_pointer(addr + self.bv.arch.address_size*2):
+    def get_result_cache(self, view_hash, discovery):
+        # Results are keyed by how they were discovered ("traced" or "scanned"):
+        # the traced entries may miss the tables a scan would find, so they are
+        # only reused by analyses that trace as well
+        mode = "unaligned" if self.unaligned else "aligned"
+        key  = f"{view_hash}-{PLUGIN_VERSION}-{self.bv.start:x}-{mode}-{discovery}"
+        return ResultCache(os.path.join(user_directory(), CACHE_DIRNAME), key)
+
+    def get_scan_ranges(self):
+        # Ranges (name, start, end) to scan: the data sections, or the regions
+        # (section names or (start, end) tuples) the analysis was restricted to
+        if self.regions is None:
+            return list(self.data_sections)
+
+        ranges = list()
+        for region in self.regions:
+            if isinstance(region, str):
+                if region not in self.bv.sections:
+                    print_err(f"[!] \"{region}\" is not a section")
                     continue
-
-                method_ptr = self.read_pointer(addr + self.bv.arch.address_size*2)
-                if not self.is_ptr_to_code(method_ptr):
+                s = self.bv.sections[region]
+                ranges.append((region, s.start, s.end))
+            else:
+                start, end = region
+                ranges.append((f"{start:#x}-{end:#x}", start, end))
+        return ranges
+
+    def get_scanned_intervals(self):
+        try:
+            records = dict(self.bv.query_metadata(SCANNED_BLOCKS_METADATA))
+        except KeyError:
+            records = dict()
+        return ScannedIntervals(records, REGION_BLOCK_SIZE)
+
+    def filter_scanned_ranges(self, ranges, scanned):
+        # Keep the parts of ranges in the REGION_BLOCK_SIZE aligned blocks that
+        # are not in an interval scanned before, or whose content changed since.
+        # The parts kept are added to scanned (ScannedIntervals)
+        overlap    = scan_overlap(self.bv.arch.address_size, JNI_NATIVE_METHOD_WORDS)
+        new_ranges = list()
+        for range_name, start, end in ranges:
+            dirty = list()
+            for part_start, part_end in iter_block_parts(start, end, REGION_BLOCK_SIZE):
+                if scanned.is_scanned(self.bv, part_start, part_end):
                     continue
+                scanned.add(part_start, part_end, get_digest(self.bv, part_start, part_end))
+
+                # Include the entries starting before the part and ending in it.
+                # The scan reads past the end of the ranges, for the entries
+                # starting at their end
+                part_start = max(start, part_start - overlap)
+                if len(dirty) > 0 and part_start <= dirty[-1][1]:
+                    dirty[-1][1] = part_end
+                else:
+                    dirty.append([part_start, part_end])
 
-                if not self.is_pointer(addr):
-                    continue
-                method_name_ptr = self.read_pointer(addr)
-                method_name = self.get_string(method_name_ptr)
-                if method_name is None:
-                    continue
+            for dirty_start, dirty_end in dirty:
+                new_ranges.append((range_name, dirty_start, dirty_end))
+        return new_ranges
 
-                if not self.is_pointer(addr + self.bv.arch.address_size):
-                    continue
-                method_signature_ptr = self.read_pointer(addr + self.bv.arch.address_size)
-                method_signature = self.get_string(method_signature_ptr)
-                if method_signature is None or len(method_signature) == 0:
-                    continue
-                if method_signature[0] != "(" or ")" not in method_signature:
+    def record_scanned_ranges(self, ranges):
+        # Record ranges as scanned without scanning them (see filter_scanned_ranges)
+        scanned = self.get_scanned_intervals()
+        for _, start, end in ranges:
+            for part_start, part_end in iter_block_parts(start, end, REGION_BLOCK_SIZE):
+                scanned.add(part_start, part_end, get_digest(self.bv, part_start, part_end))
+        self.queue_change(self.bv.store_metadata, SCANNED_BLOCKS_METADATA, scanned.as_metadata())
+
+    def find_dynamic_jni(self):
+        self.find_jni_onload()
+
+        ranges         = self.get_scan_ranges()
+        view_hash      = None
+        cached_entries = None
+        if self.use_cache and self.regions is None:
+            self.stats.progress("dynamic : hashing", 0, 1)
+            view_hash = hash_view(self.bv.file.raw or self.bv)
+            for discovery in (("traced", "scanned") if self.trace else ("scanned", )):
+                cache          = self.get_result_cache(view_hash, discovery)
+                cached_entries = cache.load()
+                if cached_entries is not None:
+                    print(f"[+] Using cached JNI methods ({cache.path})")
+                    self.method_entries = cached_entries
+                    self.stats.count("methods_cached", len(cached_entries))
+                    if discovery == "scanned":
+                        # As the scan would have, for the region scans to come
+                        self.record_scanned_ranges(ranges)
+                    break
+
+        if cached_entries is None:
+            traced_entries = None
+            if self.trace and self.regions is None:
+                self.stats.progress("dynamic : tracing RegisterNatives", 0, 1)
+                traced_entries = self.trace_register_natives()
+
+            if traced_entries is not None:
+                print(f"[+] Found {len(traced_entries)} JNI methods from the RegisterNatives calls")
+                self.method_entries = traced_entries
+                self.stats.count("methods_traced", len(traced_entries))
+            else:
+                scanned = self.get_scanned_intervals()
+                hashers = None
+                if self.regions is not None:
+                    # Region scans only process the bytes that changed since the last scan
+                    ranges = self.filter_scanned_ranges(ranges, scanned)
+                else:
+                    # Full scans record the digests of the block parts from the windows they read
+                    hashers = [BlockHasher(start, end, REGION_BLOCK_SIZE) for _, start, end in ranges]
+
+                # The candidates are validated window by window, as they are scanned
+                n_ranges   = len(ranges)
+                curr_range = None
+                for range_i, candidates in self.scan_data_sections(ranges, hashers):
+                    if range_i != curr_range:
+                        curr_range = range_i
+                        next_addr  = dict()
+                        claimed    = list() if self.unaligned else None
+                    range_name, start, _ = ranges[range_i]
+                    phase_name = " dynamic : sec \"%s\" %d/%d " % (range_name, range_i + 1, n_ranges)
+                    self.validate_candidates(phase_name, start, candidates, next_addr, claimed)
+
+                for hasher in hashers or ():
+                    for part_start, part_end, digest in hasher.digests:
+                        scanned.add(part_start, part_end, digest)
+                self.queue_change(self.bv.store_metadata, SCANNED_BLOCKS_METADATA, scanned.as_metadata())
+
+            if view_hash is not None:
+                cache = self.get_result_cache(view_hash, "scanned" if traced_entries is None else "traced")
+                try:
+                    cache.store(self.method_entries)
+                except OSError as e:
+                    print_err(f"[!] Unable to store the JNI methods cache: {e}")
+
+        self.stats.count("methods_found", len(self.method_entries))
+        for entry in self.method_entries:
+            self.queue_change(self.define_method_entry, *entry)
+
+    def trace_register_natives(self):
+        # Locate the JNINativeMethod tables from the arguments of the
+        # (*env)->RegisterNatives calls reachable from JNI_OnLoad, followed
+        # through the parameters of the functions making them up to their
+        # callers. Returns None if there are no such calls, one of them cannot
+        # be resolved or the call tree of JNI_OnLoad goes deeper than
+        # TRACE_MAX_DEPTH (the calls past it would be missed)
+        if self.jni_onload is None:
+            return None
+
+        functions, complete = get_reachable_functions(self.jni_onload, TRACE_MAX_DEPTH)
+        if not complete:
+            print(f"[!] Calls of \"{JNI_ONLOAD}\" deeper than {TRACE_MAX_DEPTH}, not tracing RegisterNatives")
+            return None
+
+        slots = {
+            offset: name for offset, name in self.get_env_slots().items()
+            if name == "RegisterNatives"
+        }
+
+        entries = dict()
+        n_calls = 0
+        for fun in functions:
+            for call, _ in iter_vtable_calls(fun, slots):
+                n_calls += 1
+                # jint RegisterNatives(JNIEnv*, jclass, const JNINativeMethod*, jint),
+                # the table is often a parameter of a registration helper
+                if len(call.params) < 4:
+                    return None
+                arguments = resolve_arguments(fun, call.params[2:4], functions, TRACE_MAX_DEPTH)
+                if arguments is None:
+                    return None
+
+                for methods_ptr, n_methods in arguments:
+                    if methods_ptr is None:
+                        return None
+                    table = self.read_method_table(methods_ptr, n_methods)
+                    if table is None:
+                        return None
+                    for entry in table:
+                        entries[entry[0]] = entry
+
+        if n_calls == 0:
+            return None
+        return list(entries.values())
+
+    def read_method_table(self, addr, n_methods):
+        # Decode the n_methods entries of the JNINativeMethod table at addr. If
+        # n_methods is unknown the table ends at the first invalid entry
+        address_size  = self.bv.arch.address_size
+        little_endian = self.bv.arch.endianness == Endianness.LittleEndian
+        entry_size    = JNI_NATIVE_METHOD_WORDS * address_size
+
+        if n_methods is not None and not 0 < n_methods <= TRACE_MAX_METHODS:
+            return None
+        data  = self.bv.read(addr, (n_methods or TRACE_MAX_METHODS) * entry_size)
+        words = unpack_words(data, address_size, little_endian)
+
+        table = list()
+        for i in range(0, len(words) - JNI_NATIVE_METHOD_WORDS + 1, JNI_NATIVE_METHOD_WORDS):
+            entry = self.decode_method_entry(words[i], words[i + 1], words[i + 2])
+            if entry is None:
+                break
+            table.append((addr + len(table) * entry_size, ) + entry)
+
+        if len(table) == 0 or (n_methods is not None and len(table) != n_methods):
+            return None
+        return table
+
+    def scan_data_sections(self, ranges, hashers=None):
+        # Scanning phase: the pre-filter runs on a pool of workers, on windows
+        # of window_size bytes of the ranges. The windows are read as the
+        # results are consumed, so that at most SCAN_WINDOWS_PER_WORKER windows
+        # per worker (and SCAN_MAX_PENDING_SIZE bytes) are in memory, and
+        # overlap by one entry so that tables straddling a boundary (at any
+        # byte offset, including the end of a range) are not missed. The
+        # windows of ranges[i] are fed to hashers[i] if given. Yields (range
+        # index, candidates of the window), in address order
+        address_size  = self.bv.arch.address_size
+        little_endian = self.bv.arch.endianness == Endianness.LittleEndian
+        overlap       = scan_overlap(address_size, JNI_NATIVE_METHOD_WORDS)
+        max_pending   = max(1, min(SCAN_WINDOWS_PER_WORKER * self.workers, SCAN_MAX_PENDING_SIZE // self.window_size))
+
+        windows = [
+            (range_i, window_start, min(self.window_size, end - window_start))
+            for range_i, (_, start, end) in enumerate(ranges)
+            for window_start in range(start, end, self.window_size)
+        ]
+
+        with make_executor(self.workers) as executor:
+            pending = collections.deque()
+
+            def next_result():
+                range_i, future = pending.popleft()
+                n_slots, rejections, candidates = future.result()
+                self.stats.count("slots_tested", n_slots)
+                for counter, n_rejected in zip(PREFILTER_COUNTERS, rejections):
+                    self.stats.count(counter, n_rejected)
+                return range_i, candidates
+
+            n_windows = len(windows)
+            for window_i, (range_i, window_start, window_size) in enumerate(windows):
+                self.stats.progress("dynamic : scanning", window_i, n_windows)
+                if len(pending) >= max_pending:
+                    yield next_result()
+
+                self.stats.count("bytes_scanned", window_size)
+                self.stats.count("windows_scanned")
+                data = self.bv.read(window_start, window_size + overlap)
+                if hashers is not None:
+                    hashers[range_i].update(window_start, data[:window_size])
+                pending.append((range_i, executor.submit(scan_chunk,
+                    data, window_start, window_size, address_size, little_endian, self.unaligned,
+                    JNI_NATIVE_METHOD_WORDS, self.code_index, self.mapped_index)))
+
+            while len(pending) > 0:
+                yield next_result()
+
+    def validate_candidates(self, phase_name, start, candidates, next_addr, claimed):
+        # Validation phase: read-only checks of the candidates of a window of
+        # the range starting at start, the recognized entries are queued in
+        # self.method_entries. next_addr (byte phase -> end of the last entry)
+        # and claimed (sorted addresses of the entries found by an unaligned
+        # scan, None otherwise) carry the state of the range from one window to the next
+        address_size = self.bv.arch.address_size
+        entry_size   = JNI_NATIVE_METHOD_WORDS * address_size
+
+        n_candidates = len(candidates)
+        for i, (addr, method_name_ptr, method_signature_ptr, method_ptr) in enumerate(candidates):
+            self.stats.progress(phase_name, i, n_candidates)
+
+            # Skip candidates inside an already recognized table
+            phase = (addr - start) % address_size
+            if addr < next_addr.get(phase, 0):
+                continue
+
+            if claimed is not None:
+                # Entries have the same size, the last one starting before addr ends last
+                i = bisect.bisect_right(claimed, addr)
+                if i > 0 and addr < claimed[i - 1] + entry_size:
                     continue
 
-                funcs = self.bv.get_functions_at(method_ptr)
-                if len(funcs) == 0:
-                    # Create the function
-                    plat = None
-                    if self.bv.arch.name == "armv7" and method_ptr % 2 == 1:
-                        thumb2 = Architecture["thumb2"]
-                        plat   = self.bv.platform.get_related_platform(thumb2)
-                        method_ptr -= 1
-                    self.bv.create_user_function(method_ptr, plat)
-                    funcs = self.bv.get_functions_at(method_ptr)
-
-                self.bv.define_user_symbol(
-                    Symbol(SymbolType.FunctionSymbol, method_ptr, f"JNI_FUN_{method_name}_{method_ptr:x}"))
-
-                fun = funcs[0]
-                self.jni_functions.append(fun)
-
-                self.bv.define_user_symbol(Symbol(SymbolType.DataSymbol, addr, f"{method_name}_struct"))
-                self.bv.define_user_data_var(addr, self.bv.types["JNINativeMethod"])
-                self.bv.define_user_data_var(method_name_ptr,
-                    Type.array(Type.char(), len(self.get_string(method_name_ptr)) + 1))
-                self.bv.define_user_data_var(method_signature_ptr,
-                    Type.array(Type.char(), len(self.get_string(method_signature_ptr)) + 1))
+            self.stats.count("candidates_tested")
+            entry = self.decode_method_entry(method_name_ptr, method_signature_ptr, method_ptr)
+            if entry is None:
+                continue
+
+            self.method_entries.append((addr, ) + entry)
+            if claimed is not None:
+                bisect.insort(claimed, addr)
+
+            # JNINativeMethod arrays are contiguous, the next entry (if any)
+            # immediately follows this one
+            next_addr[phase] = addr + entry_size
+
+    def decode_method_entry(self, method_name_ptr, method_signature_ptr, method_ptr):
+        if not self.is_ptr_to_code(method_ptr):
+            self.stats.count("rejected_code_pointer")
+            return None
+
+        method_name = self.get_string(method_name_ptr)
+        if method_name is None:
+            self.stats.count("rejected_name_pointer")
+            return None
+
+        method_signature = self.get_string(method_signature_ptr)
+        if method_signature is None or len(method_signature) == 0 or \
+                method_signature[0] != "(" or ")" not in method_signature:
+            self.stats.count("rejected_signature")
+            return None
+
+        return method_name_ptr, method_name, method_signature_ptr, method_signature, method_ptr
+
+    def get_method_address(self, method_ptr):
+        # (function address, is thumb) of the fnPtr of a JNINativeMethod: on
+        # armv7 the low bit of the pointer selects the thumb instruction set
+        if self.bv.arch.name == "armv7" and method_ptr % 2 == 1:
+            return method_ptr - 1, True
+        return method_ptr, False
+
+    def define_method_entry(self, addr, method_name_ptr, method_name,
+                            method_signature_ptr, method_signature, method_ptr):
+        funcs = self.bv.get_functions_at(method_ptr)
+        if len(funcs) == 0:
+            # Create the function
+            method_ptr, thumb = self.get_method_address(method_ptr)
+            plat = None
+            if thumb:
+                plat = self.bv.platform.get_related_platform(Architecture["thumb2"])
+            self.bv.create_user_function(method_ptr, plat)
+            self.stats.count("functions_created")
+            funcs = self.bv.get_functions_at(method_ptr)
+
+        self.bv.define_user_symbol(
+            Symbol(SymbolType.FunctionSymbol, method_ptr, f"JNI_FUN_{method_name}_{method_ptr:x}"))
+
+        fun = funcs[0]
+        self.jni_functions.append(fun)
+        self.jni_methods[fun.start] = (None, method_name, method_signature)
+
+        # Type the new function up front, so that its first analysis already uses the right prototype
+        fun_type = self.get_method_type(fun, method_signature)
+        if fun_type is not None:
+            fun.set_user_type(fun_type)
+            self.typed_functions.add(fun.start)
+            self.stats.count("functions_typed")
+
+        self.bv.define_user_symbol(Symbol(SymbolType.DataSymbol, addr, f"{method_name}_struct"))
+        self.bv.define_user_data_var(addr, self.get_jni_type("JNINativeMethod"))
+        self.bv.define_user_data_var(method_name_ptr,
+            Type.array(Type.char(), len(method_name) + 1))
+        self.bv.define_user_data_var(method_signature_ptr,
+            Type.array(Type.char(), len(method_signature) + 1))
+
+    def iter_static_symbols(self):
+        # Statically registered methods are exported as Java_<mangled name>:
+        # filter the symbol names in one pass instead of materializing every
+        # function of the view. Yields the function symbols of the methods
+        symbols   = self.bv.symbols
+        n_symbols = len(symbols)
+        for i, (name, syms) in enumerate(symbols.items()):
+            self.stats.progress("static", i, n_symbols)
+            if not name.startswith(JNI_STATIC_PREFIX):
+                continue
+            for sym in syms:
+                if sym.type == SymbolType.FunctionSymbol:
+                    yield sym
 
     def find_static_jni(self):
-        n_functions = len(self.bv.functions)
-        for i, fun in enumerate(self.bv.functions):
-            self.update_progress("static", i, n_functions)
-            if fun.name.startswith("Java_"):
-                self.jni_functions.append(fun)
+        for sym in self.iter_static_symbols():
+            funcs = self.bv.get_functions_at(sym.address)
+            if len(funcs) == 0:
+                continue
+
+            fun = funcs[0]
+            self.jni_functions.append(fun)
+            # (class name, method name, signature of the arguments if overloaded)
+            demangled = demangle_jni_name(sym.name)
+            if demangled is not None:
+                self.jni_methods[fun.start] = demangled
 
     @staticmethod
     def _build_function_type(fun, params: dict, out=None):
@@ -175,30 +660,161 @@ class FindJNIFunctionAnalysis(BackgroundTaskThread):
 
         return Type.function(out_type, param_types)
 
+    def get_method_type(self, fun, signature):
+        # Prototype of the native method fun from its JNI signature, None if the
+        # signature is unknown or invalid. The argument and return types are
+        # cached by signature, as the same signatures recur across methods
+        if signature is None:
+            return None
+
+        if signature not in self.method_types:
+            self.method_types[signature] = self.build_method_type(signature)
+        if self.method_types[signature] is None:
+            return None
+
+        # Not "return_type or ...": a Type is falsy when its width is 0, as void is
+        param_types, return_type = self.method_types[signature]
+        return Type.function(fun.return_type if return_type is None else return_type, param_types)
+
+    def build_method_type(self, signature):
+        descriptor = parse_method_descriptor(signature)
+        if descriptor is None:
+            return None
+
+        arg_type_names, return_type_name = descriptor
+
+        # Instance methods receive the object and static methods its class, a jclass is a jobject
+        param_types = [
+            Type.pointer(self.bv.arch, self.get_jni_type("JNIEnv")),
+            self.get_jni_type("jobject")
+        ]
+        for type_name in arg_type_names:
+            param_types.append(self.get_jni_type(type_name))
+
+        if return_type_name is None:
+            return_type = None
+        elif return_type_name == "void":
+            return_type = Type.void()
+        else:
+            return_type = self.get_jni_type(return_type_name)
+        return param_types, return_type
+
     def apply_types(self):
-        jnienv_ptr_type = Type.pointer(self.bv.arch, self.bv.types["JNIEnv"])
-        javavm_ptr_type = Type.pointer(self.bv.arch, self.bv.types["JavaVM"])
+        jnienv_ptr_type = Type.pointer(self.bv.arch, self.get_jni_type("JNIEnv"))
+        javavm_ptr_type = Type.pointer(self.bv.arch, self.get_jni_type("JavaVM"))
+        jobject_type    = self.get_jni_type("jobject")
 
         n_functions = len(self.jni_functions)
         for i, fun in enumerate(self.jni_functions):
-            self.update_progress("applying types", i, n_functions)
-            if len(fun.parameter_vars) == 0:
+            self.stats.progress("applying types", i, n_functions)
+            if fun.start in self.typed_functions:
                 continue
 
-            fun_type = FindJNIFunctionAnalysis._build_function_type(fun, {0: jnienv_ptr_type})
-            fun.set_user_type(fun_type)
+            _, _, signature = self.jni_methods.get(fun.start, (None, None, None))
+            fun_type = self.get_method_type(fun, signature)
+            if fun_type is None:
+                # Unknown signature, keep the parameters found by the analysis
+                if len(fun.parameter_vars) == 0:
+                    continue
+                fun_type = FindJNIFunctionAnalysis._build_function_type(
+                    fun, {0: jnienv_ptr_type, 1: jobject_type})
+
+            self.queue_change(fun.set_user_type, fun_type)
+            self.typed_functions.add(fun.start)
+            self.stats.count("functions_typed")
 
         if self.jni_onload is not None:
-            fun_type = FindJNIFunctionAnalysis._build_function_type(self.jni_onload, {0: javavm_ptr_type})
-            self.jni_onload.set_user_type(fun_type)
+            # jint JNI_OnLoad(JavaVM* vm, void* reserved)
+            fun_type = Type.function(self.get_jni_type("jint"),
+                [javavm_ptr_type, Type.pointer(self.bv.arch, Type.void())])
+            self.queue_change(self.jni_onload.set_user_type, fun_type)
+
+    def resolve_env_calls(self):
+        # Resolve the calls of the JNI functions through the JNIEnv function
+        # table to the functions they call, along with their constant string
+        # arguments, in one pass. The call sites are commented and the calls
+        # are indexed by JNIEnv function name (see query_env_calls), merged by
+        # function with the index of the view on region scans
+        slots     = self.get_env_slots()
+        functions = list(self.jni_functions)
+        if self.jni_onload is not None:
+            functions.append(self.jni_onload)
+
+        self.env_calls = dict()
+        seen        = set()
+        n_functions = len(functions)
+        for i, fun in enumerate(functions):
+            self.stats.progress("resolving JNIEnv calls", i, n_functions)
+            if fun.start in seen:
+                continue
+            seen.add(fun.start)
+
+            for call, slot_name in iter_vtable_calls(fun, slots, JNI_ENV_TYPE_NAMES):
+                strings = [self.get_call_string(call, arg_i) for arg_i in JNI_ENV_STRING_ARGS.get(slot_name, ())]
+                self.env_calls.setdefault(slot_name, list()).append((fun.start, call.address, strings))
+                self.stats.count("env_calls_resolved")
+
+                # Keep the comments set by the user
+                comment = format_env_call(slot_name, strings)
+                if fun.get_comment_at(call.address) == "":
+                    self.queue_change(fun.set_comment_at, call.address, comment)
+
+        if self.regions is not None:
+            # A region scan only finds the methods of the regions: keep the calls
+            # indexed by the previous analyses in the functions not resolved again
+            for slot_name, calls in query_env_calls(self.bv).items():
+                calls = [call for call in calls if call[0] not in seen]
+                if len(calls) == 0:
+                    continue
+                merged = self.env_calls.setdefault(slot_name, list())
+                merged.extend(calls)
+                merged.sort(key=lambda call: call[:2])
+
+        # Metadata cannot hold None, unresolved strings are stored as ""
+        self.queue_change(self.bv.store_metadata, ENV_CALLS_METADATA, {
+            name: [[fun_addr, call_addr, [s or "" for s in strings]] for fun_addr, call_addr, strings in calls]
+            for name, calls in self.env_calls.items()
+        })
+
+    def get_call_string(self, call, arg_i):
+        # Constant string passed as argument arg_i of call, None if unknown
+        if arg_i >= len(call.params):
+            return None
+        ptr = get_constant(call.params[arg_i])
+        if ptr is None or not self.is_pointer(ptr):
+            return None
+
+        s = self.get_string(ptr)
+        if s is not None:
+            self.stats.count("env_call_strings")
+        return s
 
     def run(self):
-        self.bv.update_analysis_and_wait()
-        self.define_JNI_types()
-
-        self.find_dynamic_jni()
-        self.find_static_jni()
-
-        self.apply_types()
+        with self.stats.phase("initial analysis"):
+            self.bv.update_analysis_and_wait()
+        with self.stats.phase("types"):
+            self.define_JNI_types()
+
+        with self.stats.phase("dynamic"):
+            self.find_dynamic_jni()
+        with self.stats.phase("static"):
+            self.find_static_jni()
+        # The new functions must be analyzed before their parameters can be typed
+        with self.stats.phase("commit functions"):
+            self.commit_changes("defining functions")
+
+        with self.stats.phase("apply types"):
+            self.apply_types()
+        with self.stats.phase("commit types"):
+            self.commit_changes("applying types")
+
+        # The calls through env resolve to members of JNINativeInterface once the parameters are typed
+        with self.stats.phase("env calls"):
+            self.resolve_env_calls()
+        with self.stats.phase("commit comments"):
+            self.commit_changes("annotating JNIEnv calls", reanalyze=False)
 
         print("Found %d JNI functions" % len(self.jni_functions))
+        print(self.stats.summary())
+        if self.stats_json is not None:
+            self.stats.write_json(self.stats_json)
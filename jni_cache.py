@@ -0,0 +1,128 @@
+import os
+import json
+import zlib
+import hashlib
+
+HASH_CHUNK_SIZE = 0x1000000
+
+def hash_view(view):
+    # sha256 of the whole content of view, read in chunks of HASH_CHUNK_SIZE bytes
+    h = hashlib.sha256()
+    for addr in range(view.start, view.end, HASH_CHUNK_SIZE):
+        h.update(view.read(addr, min(HASH_CHUNK_SIZE, view.end - addr)))
+    return h.hexdigest()
+
+class ResultCache(object):
+    # Discovered JNINativeMethod entries of a binary, stored as zlib compressed
+    # JSON in <directory>/<key>.json.z. Every entry is the tuple
+    # (addr, name_ptr, name, signature_ptr, signature, method_ptr)
+    def __init__(self, directory, key):
+        self.key  = key
+        self.path = os.path.join(directory, f"{key}.json.z")
+
+    def load(self):
+        try:
+            with open(self.path, "rb") as fin:
+                data = json.loads(zlib.decompress(fin.read()))
+        except (OSError, ValueError, zlib.error):
+            return None
+
+        if not isinstance(data, dict) or data.get("key") != self.key:
+            return None
+        return [tuple(entry) for entry in data["entries"]]
+
+    def store(self, entries):
+        data = json.dumps({"key": self.key, "entries": entries}, separators=(",", ":"))
+
+        # Write to a temporary file first, so that concurrent sessions never read a partial cache
+        os.makedirs(os.path.dirname(self.path), exist_ok=True)
+        tmp_path = f"{self.path}.{os.getpid()}.tmp"
+        with open(tmp_path, "wb") as fout:
+            fout.write(zlib.compress(data.encode("ascii")))
+        os.replace(tmp_path, self.path)
+
+def new_block_hash():
+    return hashlib.blake2b(digest_size=16)
+
+def get_digest(view, start, end):
+    digest = new_block_hash()
+    digest.update(view.read(start, end - start))
+    return digest.hexdigest()
+
+def iter_block_parts(start, end, block_size):
+    # Yield (part_start, part_end), the parts of [start, end) in each of the
+    # blocks aligned on block_size it overlaps
+    part_start = start
+    while part_start < end:
+        part_end = min(end, (part_start // block_size + 1) * block_size)
+        yield part_start, part_end
+        part_start = part_end
+
+class BlockHasher(object):
+    # Digests (part_start, part_end, digest) of the parts of [start, end) (see
+    # iter_block_parts), computed from the consecutive chunks of [start, end)
+    # read by a scan instead of reading them again
+    def __init__(self, start, end, block_size):
+        self.block_size = block_size
+        self.end        = end
+        self.addr       = start
+        self.part_start = start
+        self.hash       = None
+        self.digests    = list()
+
+    def update(self, addr, data):
+        if addr != self.addr:
+            # Not contiguous with the previous chunk, the current part is lost
+            self.hash       = None
+            self.part_start = (addr + self.block_size - 1) // self.block_size * self.block_size
+        self.addr = addr + len(data)
+
+        data = memoryview(data)
+        pos  = max(addr, self.part_start)
+        last = min(self.addr, self.end)
+        while pos < last:
+            part_end = min(self.end, (pos // self.block_size + 1) * self.block_size)
+            if self.hash is None:
+                self.hash       = new_block_hash()
+                self.part_start = pos
+
+            n = min(part_end, last) - pos
+            self.hash.update(data[pos - addr:pos - addr + n])
+            pos += n
+            if pos == part_end:
+                self.digests.append((self.part_start, part_end, self.hash.hexdigest()))
+                self.hash       = None
+                self.part_start = part_end
+
+class ScannedIntervals(object):
+    # Intervals of a view scanned before, with the digest of their content, by
+    # block aligned on block_size (an interval never spans two blocks). Stored
+    # in the view metadata as {"<start>-<end>": digest}
+    def __init__(self, records, block_size):
+        self.block_size = block_size
+        self.blocks     = dict()
+        for key, digest in records.items():
+            start, end = (int(addr, 16) for addr in key.split("-"))
+            self.blocks.setdefault(start // block_size, dict())[(start, end)] = digest
+
+    def is_scanned(self, view, start, end):
+        # Whether [start, end) (in a single block) is in an interval whose
+        # content did not change since it was scanned
+        for (interval_start, interval_end), digest in self.blocks.get(start // self.block_size, {}).items():
+            if interval_start <= start and end <= interval_end and \
+                    get_digest(view, interval_start, interval_end) == digest:
+                return True
+        return False
+
+    def add(self, start, end, digest):
+        # Record [start, end) as scanned, replacing the intervals of its block it covers
+        intervals = self.blocks.setdefault(start // self.block_size, dict())
+        for interval in [i for i in intervals if start <= i[0] and i[1] <= end]:
+            del intervals[interval]
+        intervals[(start, end)] = digest
+
+    def as_metadata(self):
+        return {
+            f"{start:x}-{end:x}": digest
+            for intervals in self.blocks.values() for (start, end), digest in intervals.items()
+        }
@@ -0,0 +1,203 @@
+from binaryninja import MediumLevelILOperation, RegisterValueType, SymbolType, SectionSemantics
+
+# Number of SSA definitions followed to find the expression of a call target
+MAX_DEFINITION_DEPTH = 4
+
+CALL_OPERATIONS = {
+    MediumLevelILOperation.MLIL_CALL_SSA,
+    MediumLevelILOperation.MLIL_TAILCALL_SSA
+}
+
+LOAD_OPERATIONS = {
+    MediumLevelILOperation.MLIL_LOAD_SSA,
+    MediumLevelILOperation.MLIL_LOAD
+}
+
+# Loads of a member of a typed structure, e.g. (*env)->FindClass
+LOAD_STRUCT_OPERATIONS = {
+    MediumLevelILOperation.MLIL_LOAD_STRUCT_SSA,
+    MediumLevelILOperation.MLIL_LOAD_STRUCT
+}
+
+VAR_OPERATIONS = {
+    MediumLevelILOperation.MLIL_VAR_SSA,
+    MediumLevelILOperation.MLIL_VAR_ALIASED
+}
+
+# Sections of the PLT stubs of the imported functions
+THUNK_SECTION_NAMES = {".plt", ".plt.got", ".plt.sec"}
+
+def get_vtable_slots(interface_type):
+    # Map the offsets of the members of a function pointer table (e.g.
+    # JNINativeInterface) to their names
+    structure = getattr(interface_type, "structure", None) or interface_type
+    return {member.offset: member.name for member in structure.members}
+
+def get_constant(expr):
+    value = expr.value
+    if value.type in {
+        RegisterValueType.ConstantValue,
+        RegisterValueType.ConstantPointerValue
+    }:
+        return value.value
+    return None
+
+def resolve_definition(ssa_function, expr):
+    # Follow the SSA variable copies leading to expr
+    for _ in range(MAX_DEFINITION_DEPTH):
+        if expr.operation not in VAR_OPERATIONS:
+            break
+        definition = ssa_function.get_ssa_var_definition(expr.src)
+        if definition is None or not hasattr(definition, "src"):
+            break
+        expr = definition.src
+    return expr
+
+def get_vtable_call(ssa_function, call):
+    # For a call through a function pointer table, i.e. dest = [table + offset]
+    # or table->member once the table is typed, return the tuple (table, offset)
+    # (None if the target is not in this form)
+    dest = resolve_definition(ssa_function, call.dest)
+    if dest.operation in LOAD_STRUCT_OPERATIONS:
+        return dest.src, dest.offset
+    if dest.operation not in LOAD_OPERATIONS:
+        return None
+
+    address = resolve_definition(ssa_function, dest.src)
+    if address.operation != MediumLevelILOperation.MLIL_ADD:
+        return None
+
+    for operand, table in ((address.right, address.left), (address.left, address.right)):
+        if operand.operation == MediumLevelILOperation.MLIL_CONST:
+            return table, operand.constant
+    return None
+
+def has_type_name(expr, type_names):
+    # Whether the type of expr mentions one of type_names, true if the type is unknown
+    expr_type = getattr(expr, "expr_type", None)
+    if expr_type is None:
+        return True
+    expr_type = str(expr_type)
+    return any(type_name in expr_type for type_name in type_names)
+
+def iter_vtable_calls(function, slots, type_names=None):
+    # Yield (call, slot name) for the calls of function through one of slots.
+    # With type_names, the calls through a table of another (known) type are skipped
+    mlil = function.mlil
+    if mlil is None:
+        return
+
+    ssa_function = mlil.ssa_form
+    for instr in ssa_function.instructions:
+        if instr.operation not in CALL_OPERATIONS:
+            continue
+
+        vtable_call = get_vtable_call(ssa_function, instr)
+        if vtable_call is None:
+            continue
+        table, offset = vtable_call
+        if offset not in slots:
+            continue
+        if type_names is not None and not has_type_name(table, type_names):
+            continue
+        yield instr, slots[offset]
+
+def is_import_thunk(function):
+    # Whether function is the PLT stub of an imported function or an external
+    # function, which never calls back into the library
+    symbol = function.symbol
+    if symbol is not None and symbol.type == SymbolType.ImportedFunctionSymbol:
+        return True
+    return any(
+        section.name in THUNK_SECTION_NAMES or section.semantics == SectionSemantics.ExternalSectionSemantics
+        for section in function.view.get_sections_at(function.start))
+
+def get_reachable_functions(function, max_depth):
+    # function and its callees up to max_depth calls away, as the tuple
+    # (functions, complete). complete is false if the functions max_depth
+    # calls away call functions that are not in the list. The import thunks
+    # (see is_import_thunk) are left out
+    seen      = {function.start}
+    functions = list()
+    complete  = True
+    frontier  = [function]
+    for depth in range(max_depth + 1):
+        next_frontier = list()
+        for fun in frontier:
+            functions.append(fun)
+            for callee in fun.callees:
+                if callee.start in seen or is_import_thunk(callee):
+                    continue
+                if depth == max_depth:
+                    complete = False
+                    continue
+                seen.add(callee.start)
+                next_frontier.append(callee)
+        frontier = next_frontier
+    return functions, complete
+
+def get_parameter_index(function, expr):
+    # Index of the parameter of function whose incoming value is expr (the
+    # version 0 of a parameter variable), None if expr is not a parameter
+    if expr.operation not in VAR_OPERATIONS:
+        return None
+    ssa_var = expr.src
+    if getattr(ssa_var, "version", None) != 0:
+        return None
+
+    parameter_vars = list(function.parameter_vars)
+    if ssa_var.var not in parameter_vars:
+        return None
+    return parameter_vars.index(ssa_var.var)
+
+def iter_calls_to(function, target):
+    # Yield the direct calls of function to target
+    mlil = function.mlil
+    if mlil is None:
+        return
+
+    for instr in mlil.ssa_form.instructions:
+        if instr.operation in CALL_OPERATIONS and get_constant(instr.dest) == target.start:
+            yield instr
+
+def resolve_arguments(function, args, callers, max_depth):
+    # Values of the expressions args of function, as a list of tuples (one per
+    # call path): constants, or None where an argument is not constant. The
+    # arguments that are parameters of function are resolved from the calls
+    # to function in callers, up to max_depth calls up. Returns None if one of
+    # these parameters cannot be resolved (function is not called from callers)
+    ssa_function = function.mlil.ssa_form
+    values       = list()
+    params       = dict()
+    for i, arg in enumerate(args):
+        value = get_constant(arg)
+        if value is None:
+            param_i = get_parameter_index(function, resolve_definition(ssa_function, arg))
+            if param_i is not None:
+                params[i] = param_i
+        values.append(value)
+
+    if len(params) == 0:
+        return [tuple(values)]
+    if max_depth == 0:
+        return None
+
+    resolved = list()
+    for caller in callers:
+        for call in iter_calls_to(caller, function):
+            if max(params.values()) >= len(call.params):
+                return None
+            caller_values = resolve_arguments(caller,
+                [call.params[param_i] for param_i in params.values()], callers, max_depth - 1)
+            if caller_values is None:
+                return None
+
+            for caller_value in caller_values:
+                path_values = list(values)
+                for i, value in zip(params, caller_value):
+                    path_values[i] = value
+                resolved.append(tuple(path_values))
+
+    if len(resolved) == 0:
+        return None
+    return resolved
@@ -0,0 +1,145 @@
+import functools
+
+JNI_STATIC_PREFIX = "Java_"
+
+# Escape sequences of the JNI name mangling (_0xxxx is a unicode character)
+JNI_ESCAPES = {
+    "1": "_",
+    "2": ";",
+    "3": "["
+}
+
+def demangle_jni_name(symbol_name):
+    # Decode the name of a statically registered native method, i.e.
+    # Java_<class>_<method>[__<argument descriptors>], into the tuple
+    # (class name, method name, signature). The signature (e.g. "(ILjava/lang/String;)")
+    # only holds the arguments and is None unless the method is overloaded.
+    # Returns None if symbol_name is not a valid mangled name
+    if not symbol_name.startswith(JNI_STATIC_PREFIX):
+        return None
+
+    components = [""]
+    arguments  = None
+    mangled    = symbol_name[len(JNI_STATIC_PREFIX):]
+    i = 0
+    while i < len(mangled):
+        c  = mangled[i]
+        i += 1
+        if c != "_":
+            if arguments is None:
+                components[-1] += c
+            else:
+                arguments += c
+            continue
+
+        if i == len(mangled):
+            return None
+        escape = mangled[i]
+        if escape in JNI_ESCAPES:
+            c  = JNI_ESCAPES[escape]
+            i += 1
+        elif escape == "0":
+            try:
+                c = chr(int(mangled[i + 1:i + 5], 16))
+            except ValueError:
+                return None
+            i += 5
+        elif escape == "_" and arguments is None:
+            # Overloaded method, the argument descriptors follow
+            arguments = ""
+            i += 1
+            continue
+        elif escape.isdigit():
+            return None
+        else:
+            # Package / class / method separator
+            if arguments is None:
+                components.append("")
+            else:
+                arguments += "/"
+            continue
+
+        if arguments is None:
+            components[-1] += c
+        else:
+            arguments += c
+
+    if len(components) < 2 or "" in components:
+        return None
+
+    class_name = "/".join(components[:-1])
+    signature  = None if arguments is None else f"({arguments})"
+    return class_name, components[-1], signature
+
+# JNI types of the field descriptors
+JNI_PRIMITIVE_TYPES = {
+    "Z": "jboolean",
+    "B": "jbyte",
+    "C": "jchar",
+    "S": "jshort",
+    "I": "jint",
+    "J": "jlong",
+    "F": "jfloat",
+    "D": "jdouble"
+}
+
+JNI_OBJECT_TYPES = {
+    "Ljava/lang/String;":    "jstring",
+    "Ljava/lang/Class;":     "jclass",
+    "Ljava/lang/Throwable;": "jthrowable"
+}
+
+def _parse_field_descriptor(signature, i):
+    # Parse the field descriptor starting at signature[i], return the tuple
+    # (JNI type name, index following the descriptor) or None if invalid
+    if i >= len(signature):
+        return None
+
+    c = signature[i]
+    if c in JNI_PRIMITIVE_TYPES:
+        return JNI_PRIMITIVE_TYPES[c], i + 1
+    if c == "L":
+        end = signature.find(";", i)
+        if end == -1:
+            return None
+        return JNI_OBJECT_TYPES.get(signature[i:end + 1], "jobject"), end + 1
+    if c == "[":
+        element = _parse_field_descriptor(signature, i + 1)
+        if element is None:
+            return None
+        if signature[i + 1] in JNI_PRIMITIVE_TYPES:
+            return element[0] + "Array", element[1]
+        return "jobjectArray", element[1]
+    return None
+
+@functools.lru_cache(maxsize=None)
+def parse_method_descriptor(signature):
+    # Parse a method descriptor such as "(ILjava/lang/String;[B)J" into the tuple
+    # (argument JNI type names, return JNI type name), e.g.
+    # (("jint", "jstring", "jbyteArray"), "jlong"). The return type is None if
+    # the descriptor has only the arguments (as the ones of overloaded static
+    # methods). Returns None if the descriptor is invalid
+    if not signature.startswith("("):
+        return None
+
+    arguments = list()
+    i = 1
+    while i < len(signature) and signature[i] != ")":
+        field = _parse_field_descriptor(signature, i)
+        if field is None:
+            return None
+        type_name, i = field
+        arguments.append(type_name)
+
+    if i >= len(signature):
+        return None
+    i += 1
+    if i == len(signature):
+        return tuple(arguments), None
+    if signature[i:] == "V":
+        return tuple(arguments), "void"
+
+    field = _parse_field_descriptor(signature, i)
+    if field is None or field[1] != len(signature):
+        return None
+    return tuple(arguments), field[0]
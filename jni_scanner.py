@@ -0,0 +1,150 @@
+import bisect
+import struct
+import concurrent.futures
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+WORD_FORMATS = {
+    2: "H",
+    4: "I",
+    8: "Q"
+}
+
+def unpack_words(data, address_size, little_endian, offset=0):
+    # Decode data[offset:] as an array of pointer-width unsigned integers
+    n_words = max(0, (len(data) - offset) // address_size)
+    fmt     = "%s%d%s" % ("<" if little_endian else ">", n_words, WORD_FORMATS[address_size])
+    return struct.unpack_from(fmt, data, offset)
+
+def load_words(data, address_size, little_endian, offset=0):
+    # Same as unpack_words, but backed by a numpy array when numpy is available
+    if np is None:
+        return unpack_words(data, address_size, little_endian, offset)
+
+    n_words = (len(data) - offset) // address_size
+    dtype   = np.dtype("%s%s" % ("<" if little_endian else ">", WORD_FORMATS[address_size]))
+    if n_words <= 0:
+        # data ends before offset (e.g. the last window of an unaligned scan)
+        return np.zeros(0, dtype=dtype)
+    return np.frombuffer(data, dtype=dtype, count=n_words, offset=offset)
+
+class IntervalIndex(object):
+    # Sorted, non-overlapping set of [begin, end) ranges answering membership
+    # queries with a binary search (or a vectorized searchsorted on arrays)
+    def __init__(self, ranges):
+        merged = list()
+        for begin, end in sorted(ranges):
+            if begin >= end:
+                continue
+            if len(merged) > 0 and begin <= merged[-1][1]:
+                merged[-1][1] = max(merged[-1][1], end)
+            else:
+                merged.append([begin, end])
+
+        self.starts = [begin for begin, _ in merged]
+        self.ends   = [end for _, end in merged]
+
+    def __contains__(self, value):
+        i = bisect.bisect_right(self.starts, value) - 1
+        return i >= 0 and value < self.ends[i]
+
+    def mask(self, values):
+        starts = np.array(self.starts, dtype=np.uint64)
+        ends   = np.array(self.ends, dtype=np.uint64)
+        if len(starts) == 0:
+            return np.zeros(len(values), dtype=bool)
+
+        values = values.astype(np.uint64, copy=False)
+        i      = np.searchsorted(starts, values, side="right") - 1
+        return (i >= 0) & (values < ends[np.maximum(i, 0)])
+
+def iter_candidates(words, entry_words, code_index, mapped_index, rejections=None):
+    # Yield (index, name_ptr, signature_ptr, method_ptr) for every index of words
+    # whose method pointer falls in code_index and whose name and signature
+    # pointers fall in mapped_index (both IntervalIndex). The pointers are
+    # returned as python ints. The checks run in this order, the entries
+    # rejected by each one are added to rejections ([code, name, signature]) if given
+    n_candidates = len(words) - entry_words + 1
+    if n_candidates <= 0:
+        return
+
+    if np is None or not isinstance(words, np.ndarray):
+        for i in range(n_candidates):
+            method_ptr = words[i + 2]
+            if method_ptr not in code_index:
+                if rejections is not None:
+                    rejections[0] += 1
+                continue
+            name_ptr = words[i]
+            if name_ptr not in mapped_index:
+                if rejections is not None:
+                    rejections[1] += 1
+                continue
+            signature_ptr = words[i + 1]
+            if signature_ptr not in mapped_index:
+                if rejections is not None:
+                    rejections[2] += 1
+                continue
+            yield i, name_ptr, signature_ptr, method_ptr
+        return
+
+    name_ptrs      = words[0:n_candidates]
+    signature_ptrs = words[1:n_candidates + 1]
+    method_ptrs    = words[2:n_candidates + 2]
+
+    code_mask = code_index.mask(method_ptrs)
+    name_mask = code_mask & mapped_index.mask(name_ptrs)
+    mask      = name_mask & mapped_index.mask(signature_ptrs)
+    if rejections is not None:
+        n_code = int(np.count_nonzero(code_mask))
+        n_name = int(np.count_nonzero(name_mask))
+        rejections[0] += n_candidates - n_code
+        rejections[1] += n_code - n_name
+        rejections[2] += n_name - int(np.count_nonzero(mask))
+
+    indices = np.flatnonzero(mask)
+    yield from zip(
+        indices.tolist(),
+        name_ptrs[indices].tolist(),
+        signature_ptrs[indices].tolist(),
+        method_ptrs[indices].tolist())
+
+def scan_chunk(data, base, size, address_size, little_endian, unaligned,
+               entry_words, code_index, mapped_index):
+    # Pure scanning phase, safe to run in a worker thread or process: return the
+    # number of slots tested, the number of slots rejected by each check of
+    # iter_candidates ([code, name, signature]) and the pre-filtered candidates
+    # (addr, name_ptr, signature_ptr, method_ptr) starting in [base, base + size),
+    # sorted by byte phase and address. data starts at base and extends
+    # scan_overlap bytes past size (when available) to cover the entries
+    # straddling the chunk end.
+    phases     = range(address_size) if unaligned else [(-base) % address_size]
+    n_slots    = 0
+    rejections = [0, 0, 0]
+    candidates = list()
+    for phase in phases:
+        words = load_words(data, address_size, little_endian, phase)
+        # Only the slots starting in the chunk, whose entry is entirely in data
+        n_phase_slots = max(0, min((size - phase + address_size - 1) // address_size,
+                                   len(words) - entry_words + 1))
+        n_slots += n_phase_slots
+        for i, name_ptr, signature_ptr, method_ptr in iter_candidates(
+                words[:n_phase_slots + entry_words - 1], entry_words, code_index, mapped_index, rejections):
+            candidates.append((base + phase + i * address_size, name_ptr, signature_ptr, method_ptr))
+    return n_slots, rejections, candidates
+
+def scan_overlap(address_size, entry_words):
+    # Bytes past the end of a chunk that scan_chunk must be given: an unaligned
+    # entry starting in the last slot of the chunk extends up to
+    # entry_words * address_size - 1 bytes past it
+    return entry_words * address_size
+
+def make_executor(workers):
+    # Threads, not processes: forking would duplicate a process running the
+    # multithreaded Binary Ninja core, and spawned workers would have to import
+    # the plugin (and binaryninja) again. numpy releases the GIL for most of the
+    # pre-filter, batch.py parallelizes across libraries with processes
+    return concurrent.futures.ThreadPoolExecutor(max_workers=workers)
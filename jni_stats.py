@@ -0,0 +1,83 @@
+import time
+import json
+import contextlib
+
+# The progress text of the task is updated at most once every PROGRESS_INTERVAL seconds
+PROGRESS_INTERVAL = 0.25
+
+# Counters reported by the summary, in this order
+COUNTERS = (
+    "bytes_scanned",
+    "windows_scanned",
+    "slots_tested",
+    "candidates_tested",
+    "rejected_code_pointer",
+    "rejected_name_pointer",
+    "rejected_signature",
+    "strings_decoded",
+    "string_cache_hits",
+    "methods_found",
+    "methods_cached",
+    "methods_traced",
+    "functions_created",
+    "functions_typed",
+    "env_calls_resolved",
+    "env_call_strings"
+)
+
+class AnalysisStats(object):
+    # Throttled progress reporting and per-phase counters / wall times of the analysis
+    def __init__(self, set_progress, title):
+        self.set_progress  = set_progress
+        self.title         = title
+        self.counters      = dict.fromkeys(COUNTERS, 0)
+        self.phase_times   = dict()
+        self.start_time    = time.perf_counter()
+        self.last_progress = 0.0
+
+    def progress(self, phase_name, curr, total):
+        now = time.perf_counter()
+        if now - self.last_progress < PROGRESS_INTERVAL:
+            return
+        self.last_progress = now
+        self.set_progress(f"{self.title} ({phase_name}): {curr} / {total}")
+
+    def count(self, name, n=1):
+        self.counters[name] += n
+
+    @contextlib.contextmanager
+    def phase(self, name):
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.phase_times[name] = self.phase_times.get(name, 0.0) + time.perf_counter() - start
+
+    @property
+    def wall_time(self):
+        return time.perf_counter() - self.start_time
+
+    def as_dict(self):
+        return {
+            "wall_time": self.wall_time,
+            "phases":    dict(self.phase_times),
+            "counters":  dict(self.counters)
+        }
+
+    def summary(self):
+        lines = ["[+] %s: %.3fs" % (self.title, self.wall_time)]
+        for name, t in self.phase_times.items():
+            lines.append("    %-24s %.3fs" % (name, t))
+        for name, value in self.counters.items():
+            if value != 0:
+                lines.append("    %-24s %d" % (name, value))
+
+        scan_time = self.phase_times.get("dynamic", 0.0)
+        if self.counters["bytes_scanned"] > 0 and scan_time > 0:
+            lines.append("    %-24s %.1f MB/s" % (
+                "scan throughput", self.counters["bytes_scanned"] / 0x100000 / scan_time))
+        return "\n".join(lines)
+
+    def write_json(self, path):
+        with open(path, "w") as fout:
+            json.dump(self.as_dict(), fout, indent=2)
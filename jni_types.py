@@ -0,0 +1,88 @@
+import os
+import sys
+import hashlib
+
+from binaryninja import Platform, TypeLibrary, user_directory
+
+SCRIPTDIR       = os.path.dirname(os.path.realpath(__file__))
+JNI_HEADER      = os.path.join(SCRIPTDIR, "jni.h")
+TYPELIB_DIRNAME = "typelibs"
+
+# Metadata of the type libraries holding the sha256 of the jni.h they were built from
+HEADER_HASH_METADATA = "jni_header_sha256"
+
+# Platforms for which the type libraries shipped in SCRIPTDIR/typelibs are generated
+TYPELIB_PLATFORMS = (
+    "linux-armv7",
+    "linux-thumb2",
+    "linux-aarch64",
+    "linux-x86",
+    "linux-x86_64"
+)
+
+def type_library_name(arch):
+    return f"jni-{arch.name}"
+
+def type_library_dirs():
+    # Prebuilt libraries shipped with the plugin first, then the ones generated on demand
+    return [
+        os.path.join(SCRIPTDIR, TYPELIB_DIRNAME),
+        os.path.join(user_directory(), "jni_" + TYPELIB_DIRNAME)
+    ]
+
+def header_hash():
+    with open(JNI_HEADER, "rb") as fin:
+        return hashlib.sha256(fin.read()).hexdigest()
+
+def library_header_hash(lib):
+    try:
+        return lib.query_metadata(HEADER_HASH_METADATA)
+    except KeyError:
+        return None
+
+def build_type_library(platform):
+    with open(JNI_HEADER, "r") as fin:
+        data = fin.read()
+
+    jni_types = platform.parse_types_from_source(data)
+
+    lib = TypeLibrary.new(platform.arch, type_library_name(platform.arch))
+    lib.add_platform(platform)
+    for type_name in jni_types.types:
+        lib.add_named_type(type_name, jni_types.types[type_name])
+    lib.store_metadata(HEADER_HASH_METADATA, header_hash())
+    lib.finalize()
+    return lib
+
+def load_type_library(platform):
+    # Load the JNI type library of the architecture of platform. When no
+    # library built from the current jni.h exists (checked by content, file
+    # times are not preserved by checkouts) it is built from jni.h (the only
+    # time the C parser runs) and saved for the next sessions
+    file_name = type_library_name(platform.arch) + ".bntl"
+    expected  = header_hash()
+    for directory in type_library_dirs():
+        path = os.path.join(directory, file_name)
+        if os.path.isfile(path):
+            lib = TypeLibrary.load_from_file(path)
+            if lib is not None and library_header_hash(lib) == expected:
+                return lib
+
+    lib  = build_type_library(platform)
+    path = os.path.join(type_library_dirs()[-1], file_name)
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        lib.write_to_file(path)
+    except OSError as e:
+        sys.stderr.write(f"[!] Unable to store the JNI type library: {e}\n")
+    return lib
+
+if __name__ == "__main__":
+    # Generate the type libraries shipped with the plugin
+    out_dir = os.path.join(SCRIPTDIR, TYPELIB_DIRNAME)
+    os.makedirs(out_dir, exist_ok=True)
+    for platform_name in TYPELIB_PLATFORMS:
+        platform = Platform[platform_name]
+        path     = os.path.join(out_dir, type_library_name(platform.arch) + ".bntl")
+        build_type_library(platform).write_to_file(path)
+        print(f"[+] {path}")